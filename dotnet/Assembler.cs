@@ -36,6 +36,17 @@ namespace Compiler
         /// </summary>
         public abstract int SlotCount();
 
+        /// <summary>
+        /// Returns the number of variables in the stack frame, parameters not included.
+        /// </summary>
+        public abstract int VariableCount();
+
+        /// <summary>
+        /// Returns the position of the variable in the stack frame, counting down from the frame pointer.
+        /// Slots that are not variables of this frame, like parameters, return -1.
+        /// </summary>
+        public abstract int VariableIndex(int slot);
+
         /// <summary>
         /// Prepares the stack and context for stacktraces and garbage collection.
         /// </summary>
@@ -129,10 +140,12 @@ namespace Compiler
 
         /// <summary>
         /// Stores the Accumulator into a field of the top of the stack.
+        /// The write barrier is checked inline, the touch function is only called when the store needs it.
         /// </summary>
         /// <param name="touch">Touch function of the garbage collector.</param>
+        /// <param name="barrier">Barrier state block of the garbage collector.</param>
         /// <param name="slot">Field number of the slot in Accumulator</param>
-        public abstract void StoreInFieldOfSlot(Placeholder touch, int slot);
+        public abstract void StoreInFieldOfSlot(Placeholder touch, Placeholder barrier, int slot);
 
         /// <summary>
         /// Stores the Accumulator into a field of the top of the stack.
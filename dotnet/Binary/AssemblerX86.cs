@@ -107,6 +107,18 @@ namespace Compiler.Binary
             return parameters + variables;
         }
 
+        public override int VariableCount()
+        {
+            return variables;
+        }
+
+        public override int VariableIndex(int slot)
+        {
+            if (slot < parameters)
+                return -1;
+            return slot - parameters;
+        }
+
         private int StackOffset(int slot)
         {
             if (slot < parameters)
@@ -369,7 +381,13 @@ namespace Compiler.Binary
             region.Write(code);
         }
 
-        public override void StoreInFieldOfSlot(Placeholder touch, int slot)
+        /// <summary>
+        /// The barrier only calls touch for a stored old object that is still unmarked while marking,
+        /// or for a young object stored into an old one. The page layout tested here is the one of lib/Heap.c,
+        /// mark bits of 8 byte granules at the start of every 64k page followed by the young flag. The young flag
+        /// is read from the page of the object, not of the slot, only the first page of a large object has a header.
+        /// </summary>
+        public override void StoreInFieldOfSlot(Placeholder touch, Placeholder barrier, int slot)
         {
             int offset = slot * 4;
             region.Write(new byte[] {
@@ -393,10 +411,54 @@ namespace Compiler.Binary
                 0x03, 0x0c, 0x24,           // add ecx, [esp]
                 0x89, 0x01,                 // mov [ecx], eax
                 0x89, 0x51, 0x04,           // mov [ecx+4], edx
-                0x51, // push ecx
-                0xff, 0x15 // call [IMM32]
+                0x51,                       // push ecx
+                0x85, 0xd2,                 // test edx, edx
+                0x74, 0x6c,                 // jz done
+                0x83, 0x3a, 0x00,           // cmp dword [edx], 0
+                0x74, 0x67,                 // je done
+                0x85, 0xc0,                 // test eax, eax
+                0x74, 0x63,                 // jz done
+                0x89, 0xc2,                 // mov edx, eax
+                0x2b, 0x15                  // sub edx, [IMM32]
+            });
+            region.WritePlaceholder(barrier);
+            region.Write(new byte[] { 0x3b, 0x15 }); // cmp edx, [IMM32]
+            region.WritePlaceholder(barrier.Increment(4));
+            region.Write(new byte[] {
+                0x73, 0x53,                 // jae done
+                0x89, 0xc2,                 // mov edx, eax
+                0x81, 0xe2, 0x00, 0x00, 0xff, 0xff, // and edx, ~0xffff
+                0x80, 0xba, 0x00, 0x04, 0x00, 0x00, 0x00, // cmp byte [edx+1024], 0 (young)
+                0x74, 0x23,                 // je old
+                0x2b, 0x0d                  // sub ecx, [IMM32]
+            });
+            region.WritePlaceholder(barrier);
+            region.Write(new byte[] { 0x3b, 0x0d }); // cmp ecx, [IMM32]
+            region.WritePlaceholder(barrier.Increment(4));
+            region.Write(new byte[] {
+                0x73, 0x34,                 // jae done
+                0x8b, 0x4c, 0x24, 0x04,     // mov ecx, [esp+4] (the object, a slot can lie past the first page of a large one)
+                0x81, 0xe1, 0x00, 0x00, 0xff, 0xff, // and ecx, ~0xffff
+                0x80, 0xb9, 0x00, 0x04, 0x00, 0x00, 0x00, // cmp byte [ecx+1024], 0 (young)
+                0x75, 0x21,                 // jne done
+                0xeb, 0x19,                 // jmp slow
+                // old:
+                0x80, 0x3d                  // cmp byte [IMM32], 0 (marking)
+            });
+            region.WritePlaceholder(barrier.Increment(8));
+            region.Write(new byte[] {
+                0x00,
+                0x74, 0x16,                 // je done
+                0x89, 0xc1,                 // mov ecx, eax
+                0xc1, 0xe9, 0x03,           // shr ecx, 3
+                0x81, 0xe1, 0xff, 0x1f, 0x00, 0x00, // and ecx, 0x1fff
+                0x0f, 0xa3, 0x0a,           // bt [edx], ecx
+                0x72, 0x06,                 // jc done
+                // slow:
+                0xff, 0x15                  // call [IMM32]
             });
             region.WritePlaceholder(touch);
+            // done:
             region.Write(new byte[] {
                 0x59,                       // pop ecx
                 0x59,                       // pop ecx
@@ -51,6 +51,18 @@ namespace Compiler.Binary
             return parameters + variables;
         }
 
+        public override int VariableCount()
+        {
+            return variables;
+        }
+
+        public override int VariableIndex(int slot)
+        {
+            if (slot < parameters)
+                return -1;
+            return slot - parameters;
+        }
+
         /// <summary>
         /// Prepares the stack and context for stacktraces and garbage collection.
         /// </summary>
@@ -719,10 +731,15 @@ namespace Compiler.Binary
 
         /// <summary>
         /// Stores the Accumulator into a field of the top of the stack.
+        /// The barrier only calls touch for a stored old object that is still unmarked while marking,
+        /// or for a young object stored into an old one. The page layout tested here is the one of lib/Heap.c,
+        /// mark bits of 16 byte granules at the start of every 64k page followed by the young flag. The young flag
+        /// is read from the page of the object, not of the slot, only the first page of a large object has a header.
         /// </summary>
         /// <param name="touch">Touch function of the garbage collector, may be 0 for non gc'ed types.</param>
+        /// <param name="barrier">Barrier state block, arena start, arena size and the marking flag.</param>
         /// <param name="slot">Field number of the slot in Accumulator</param>
-        public override void StoreInFieldOfSlot(Placeholder touch, int slot)
+        public override void StoreInFieldOfSlot(Placeholder touch, Placeholder barrier, int slot)
         {
             int offset = slot * 8;
             Require.True((int.MaxValue >= offset) && (int.MinValue <= offset));
@@ -735,11 +752,48 @@ namespace Compiler.Binary
                 0x48, 0x03, 0x0c, 0x24, // add rcx , [rsp]
                 0x48, 0x89, 01, // mov [rcx], rax
                 0x48, 0x89, 0x51, 0x08, // mov [rcx+8] rdx
+                0x48, 0x85, 0xd2, // test rdx, rdx
+                0x74, 0x77, // jz done
+                0x48, 0x83, 0x3a, 0x00, // cmp qword [rdx], 0
+                0x74, 0x71, // je done
+                0x48, 0x85, 0xc0, // test rax, rax
+                0x74, 0x6c, // jz done
+                0x4c, 0x8d, 0x1d // lea r11, [rip+disp]
+            });
+            region.WritePlaceholderDisplacement32(barrier);
+            region.Write(new byte[] {
+                0x48, 0x89, 0xc6, // mov rsi, rax
+                0x49, 0x2b, 0x33, // sub rsi, [r11]
+                0x49, 0x3b, 0x73, 0x08, // cmp rsi, [r11+8]
+                0x73, 0x59, // jae done
+                0x48, 0x89, 0xc6, // mov rsi, rax
+                0x48, 0x81, 0xe6, 0x00, 0x00, 0xff, 0xff, // and rsi, ~0xffff
+                0x80, 0xbe, 0x00, 0x02, 0x00, 0x00, 0x00, // cmp byte [rsi+512], 0 (young)
+                0x74, 0x22, // je old
+                0x48, 0x89, 0xcf, // mov rdi, rcx
+                0x49, 0x2b, 0x3b, // sub rdi, [r11]
+                0x49, 0x3b, 0x7b, 0x08, // cmp rdi, [r11+8]
+                0x73, 0x3a, // jae done
+                0x48, 0x8b, 0x3c, 0x24, // mov rdi, [rsp] (the object, a slot can lie past the first page of a large one)
+                0x48, 0x81, 0xe7, 0x00, 0x00, 0xff, 0xff, // and rdi, ~0xffff
+                0x80, 0xbf, 0x00, 0x02, 0x00, 0x00, 0x00, // cmp byte [rdi+512], 0 (young)
+                0x75, 0x26, // jne done
+                0xeb, 0x17, // jmp slow
+                // old:
+                0x41, 0x80, 0x7b, 0x10, 0x00, // cmp byte [r11+16], 0 (marking)
+                0x74, 0x1d, // je done
+                0x89, 0xc7, // mov edi, eax
+                0xc1, 0xef, 0x04, // shr edi, 4
+                0x81, 0xe7, 0xff, 0x0f, 0x00, 0x00, // and edi, 0xfff
+                0x0f, 0xa3, 0x3e, // bt [rsi], edi
+                0x72, 0x0d, // jc done
+                // slow:
+                0x48, 0x89, 0xcf, // mov rdi, rcx
+                0x4c, 0x8d, 0x1d // lea r11, [rip+disp]
             });
-            region.Write(new byte[] { 0x48, 0x89, 0xcf }); // mov rdi, rcx
-            region.Write(new byte[] { 0x4c, 0x8d, 0x1d }); // lea r11, [rip+disp]
             region.WritePlaceholderDisplacement32(touch);
             region.Write(new byte[] { 0x41, 0xff, 0x13 }); // call [r11]
+            // done:
             region.Write(new byte[] {
                 0x59, 0x59 // pop rcx; pop rcx
             });
@@ -34,6 +34,13 @@ namespace Compiler.Binary.LinuxELF32X86
 
             statics = sections.GetSection(".data").AllocateRegion();
 
+            // arena start, arena size and marking flag for the inlined write barrier, filled in by the runtime
+            Region barrierData = sections.GetSection(".data").AllocateRegion();
+            barrier = barrierData.CurrentLocation;
+            barrierData.WriteNumber(0);
+            barrierData.WriteNumber(0);
+            barrierData.WriteNumber(0);
+
             SetExternals(
                    importer.FetchImportAsPointer("pluk.base", "pluk_allocateGC"),
                    importer.FetchImportAsPointer("pluk.base", "pluk_touchGC"),
@@ -107,6 +114,7 @@ namespace Compiler.Binary.LinuxELF32X86
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(location.Source));
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(definition));
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(method));
+            WriteFrameMap(stackTraceData);
         }
 
         protected override Compiler.Assembler InnerAllocateAssembler()
@@ -32,6 +32,13 @@ namespace Compiler.Binary.WinPE32X86
 
             statics = writer.AllocateRegion(".data");
 
+            // arena start, arena size and marking flag for the inlined write barrier, filled in by the runtime
+            Region barrierData = writer.AllocateRegion(".data");
+            barrier = barrierData.CurrentLocation;
+            barrierData.WriteNumber(0);
+            barrierData.WriteNumber(0);
+            barrierData.WriteNumber(0);
+
             SetExternals(
                    importer.FetchImportAsPointer("pluk.base", "pluk_allocateGC"),
                    importer.FetchImportAsPointer("pluk.base", "pluk_touchGC"),
@@ -103,6 +110,7 @@ namespace Compiler.Binary.WinPE32X86
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(location.Source));
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(definition));
             stackTraceData.WritePlaceholder(AddTextLengthPrefix(method));
+            WriteFrameMap(stackTraceData);
         }
 
         protected override Compiler.Assembler InnerAllocateAssembler()
@@ -18,7 +18,10 @@ namespace Compiler
         private Placeholder setup;
         private Placeholder saveStackRoot;
         protected Placeholder callStack;
+        protected Placeholder barrier;
         private Region overflowExceptionRegion;
+        private Region frameMapRegion;
+        private Dictionary<string, Placeholder> frameMaps = new Dictionary<string, Placeholder>();
 
         public abstract Importer Importer { get; }
         public abstract Symbols Symbols { get; }
@@ -32,6 +35,7 @@ namespace Compiler
         public Placeholder Setup { get { return setup; } }
         public Placeholder SaveStackRoot { get { return saveStackRoot; } }
         public Placeholder CallStackData { get { return callStack; } }
+        public Placeholder Barrier { get { return barrier; } }
         public Placeholder OverflowException { get { return overflowExceptionRegion.BaseLocation; } }
         public Region OverflowExceptionRegion { get { return overflowExceptionRegion; } }
 
@@ -61,12 +65,14 @@ namespace Compiler
             {
                 Require.Assigned(value);
                 assembler = value; ;
+                resolver.CurrentAssembler = value;
             }
         }
 
         public void AllocateAssembler()
         {
             assembler = InnerAllocateAssembler();
+            resolver.CurrentAssembler = assembler;
         }
 
         public abstract Region AllocateDataRegion();
@@ -79,6 +85,53 @@ namespace Compiler
 
         protected abstract Assembler InnerAllocateAssembler();
 
+        /// <summary>
+        /// Writes the frame map of the call site being generated, used by the garbage collector to skip variables while scanning
+        /// the frame of the caller. The map holds the variable count of the frame followed by a bitmap with a bit set for every
+        /// variable that can be skipped. Zero is written when all variables have to be scanned.
+        /// </summary>
+        protected void WriteFrameMap(Region region)
+        {
+            if ((assembler == null) || (resolver.CurrentAssembler != assembler))
+            {
+                region.WriteNumber(0);
+                return;
+            }
+            int count = assembler.VariableCount();
+            int bits = region.SizeOfWord * 8;
+            long[] words = new long[(count + bits - 1) / bits];
+            bool any = false;
+            foreach (int slot in resolver.UnscannedSlots())
+            {
+                int index = assembler.VariableIndex(slot);
+                if ((index < 0) || (index >= count))
+                    continue;
+                words[index / bits] |= 1L << (index % bits);
+                any = true;
+            }
+            if (!any)
+            {
+                region.WriteNumber(0);
+                return;
+            }
+            StringBuilder key = new StringBuilder();
+            key.Append(count);
+            foreach (long word in words)
+                key.Append(':').Append(word);
+            Placeholder map;
+            if (!frameMaps.TryGetValue(key.ToString(), out map))
+            {
+                if (frameMapRegion == null)
+                    frameMapRegion = AllocateDataRegion();
+                map = frameMapRegion.CurrentLocation;
+                frameMapRegion.WriteNumber(count);
+                foreach (long word in words)
+                    frameMapRegion.WriteNumber(word);
+                frameMaps[key.ToString()] = map;
+            }
+            region.WritePlaceholder(map);
+        }
+
         protected void SetExternals(Placeholder allocator, Placeholder toucher, Placeholder disposer, Placeholder exit, Placeholder setup, Placeholder saveStackRoot)
         {
             this.allocator = allocator;
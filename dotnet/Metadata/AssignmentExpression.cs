@@ -154,10 +154,17 @@ namespace Compiler.Metadata
                         if (slot.IsNullable)
                             slot = ((NullableTypeReference)slot).Parent;
                         DefinitionTypeReference dtr = slot as DefinitionTypeReference;
+                        TypeReference stored = value.TypeReference;
+                        if ((stored != null) && stored.IsNullable)
+                            stored = ((NullableTypeReference)stored).Parent;
+                        DefinitionTypeReference vtr = stored as DefinitionTypeReference;
                         if ((dtr != null) && (!dtr.Definition.GarbageCollectable))
                             generator.Assembler.StoreInFieldOfSlotNoTouch(fieldOffset);
+                        // Int, Bool, Float and Byte values keep their runtime type when converted to a base, they never need the barrier
+                        else if ((dtr != null) && (vtr != null) && (!vtr.Definition.GarbageCollectable) && vtr.Definition.Supports(dtr))
+                            generator.Assembler.StoreInFieldOfSlotNoTouch(fieldOffset);
                         else
-                            generator.Assembler.StoreInFieldOfSlot(generator.Toucher, fieldOffset);
+                            generator.Assembler.StoreInFieldOfSlot(generator.Toucher, generator.Barrier, fieldOffset);
                     }
                     else
                     {
@@ -25,6 +25,18 @@ namespace Compiler.Metadata
             return expression.SlotCount();
         }
 
+        public override int VariableCount()
+        {
+            return code.VariableCount();
+        }
+
+        public override int VariableIndex(int slot)
+        {
+            if (expression.IsClosureSlot(slot))
+                return -1;
+            return code.VariableIndex(expression.LocalSlot(slot));
+        }
+
         public override void RetrieveVariable(int slot)
         {
             if (expression.IsClosureSlot(slot))
@@ -77,7 +89,7 @@ namespace Compiler.Metadata
         public override void CallAllocator(Placeholder allocator, int size, Placeholder type)
         { code.CallAllocator(allocator, size, type); }
         public override void Empty() { code.Empty(); }
-        public override void StoreInFieldOfSlot(Placeholder touch, int slot) { code.StoreInFieldOfSlot(touch, slot); }
+        public override void StoreInFieldOfSlot(Placeholder touch, Placeholder barrier, int slot) { code.StoreInFieldOfSlot(touch, barrier, slot); }
         public override void StoreInFieldOfSlotNoTouch(int slot) { code.StoreInFieldOfSlotNoTouch(slot); }
         public override void SetValue(Placeholder type, Placeholder value) { code.SetValue(type, value); }
         public override void SetImmediateValue(Placeholder type, long value) { code.SetImmediateValue(type, value); }
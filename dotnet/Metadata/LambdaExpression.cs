@@ -179,7 +179,7 @@ namespace Compiler.Metadata
                 generator.Assembler.PushValue();
                 generator.Assembler.PushValue();
                 generator.Assembler.RetrieveVariable(kv.Key);
-                generator.Assembler.StoreInFieldOfSlot(generator.Toucher, kv.Value);
+                generator.Assembler.StoreInFieldOfSlot(generator.Toucher, generator.Barrier, kv.Value);
                 generator.Assembler.PopValue();
             }
         }
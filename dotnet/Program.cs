@@ -371,7 +371,7 @@ namespace Compiler
             classType = new TypeName(new Identifier(new NowhereLocation(), "pluk.base.BoundsException"));
             definition = generator.Resolver.ResolveDefinitionType(new NowhereLocation(), classType).Definition;
             Placeholder boundsType = definition.RuntimeStruct;
-            generator.Assembler.CallBuildIn(generator.Setup, new Placeholder[] { boolType, byteType, intType, floatType, stringType, staticStringType, typeType, generator.CallStackData, generator.Statics.BaseLocation, generator.Statics.CurrentLocation, overflowType, boundsType });
+            generator.Assembler.CallBuildIn(generator.Setup, new Placeholder[] { boolType, byteType, intType, floatType, stringType, staticStringType, typeType, generator.CallStackData, generator.Statics.BaseLocation, generator.Statics.CurrentLocation, overflowType, boundsType, generator.Barrier });
         }
     }
 }
@@ -34,15 +34,18 @@ namespace Compiler
             public Dictionary<string, JumpToken> gotos = new Dictionary<string, JumpToken>();
             public bool tryContext;
             public Parameters contextParameters;
+            public Assembler owner;
+            public List<int> retiredSlots = new List<int>();
 
             public Context()
             {
             }
 
-            public void Setup(Context parent, bool parentReadOnly)
+            public void Setup(Context parent, bool parentReadOnly, Assembler owner)
             {
                 this.parent = parent;
                 this.parentReadOnly = parentReadOnly;
+                this.owner = owner;
                 if (parentReadOnly)
                     Require.Assigned(parent);
             }
@@ -61,6 +64,8 @@ namespace Compiler
                 gotos.Clear();
                 tryContext = false;
                 contextParameters = null;
+                owner = null;
+                retiredSlots.Clear();
             }
 
             public void CheckEmpty()
@@ -193,6 +198,16 @@ namespace Compiler
                     variableUsed[key] = true;
             }
 
+            // variables of a block that was left can not be read anymore, their slots are not handed out again within the frame
+            public void Retire(Context context)
+            {
+                if (context.parentReadOnly || (context.owner != owner))
+                    return;
+                foreach (Entry v in context.variables.Values)
+                    retiredSlots.Add(v.slot);
+                retiredSlots.AddRange(context.retiredSlots);
+            }
+
             public void MergeReads(Context context)
             {
                 foreach (Entry v in context.variables.Values)
@@ -630,6 +645,9 @@ namespace Compiler
         private string currentFieldName;
         public string CurrentFieldName { get { return currentFieldName; } set { currentFieldName = value; } }
 
+        private Assembler currentAssembler;
+        public Assembler CurrentAssembler { get { return currentAssembler; } set { currentAssembler = value; } }
+
         Definition currentDefinition;
         Definition savedDefinition;
 
@@ -665,21 +683,21 @@ namespace Compiler
             Require.Unassigned(currentDefinition);
             currentDefinition = definition;
             Context context = CreateContext();
-            context.Setup(null, false);
+            context.Setup(null, false, currentAssembler);
             contexts.Push(context);
         }
 
         public void EnterContext()
         {
             Context context = CreateContext();
-            context.Setup(contexts.Peek(), false);
+            context.Setup(contexts.Peek(), false, currentAssembler);
             contexts.Push(context);
         }
 
         public void EnterContextParentReadOnly()
         {
             Context context = CreateContext();
-            context.Setup(contexts.Peek(), true);
+            context.Setup(contexts.Peek(), true, currentAssembler);
             contexts.Push(context);
         }
 
@@ -690,7 +708,10 @@ namespace Compiler
             if (contexts.Count == 0)
                 currentDefinition = null;
             else
+            {
                 contexts.Peek().MergeReads(context);
+                contexts.Peek().Retire(context);
+            }
             ReleaseContext(context);
         }
 
@@ -701,7 +722,10 @@ namespace Compiler
             if (contexts.Count == 0)
                 currentDefinition = null;
             else
+            {
                 contexts.Peek().MergeReads(context);
+                contexts.Peek().Retire(context);
+            }
             return context;
         }
 
@@ -726,7 +750,10 @@ namespace Compiler
             if (contexts.Count == 0)
                 currentDefinition = null;
             else
+            {
                 contexts.Peek().Merge(context);
+                contexts.Peek().Retire(context);
+            }
             ReleaseContext(context);
         }
 
@@ -804,6 +831,41 @@ namespace Compiler
             contexts.Peek().SetImplicitFields(slot, type);
         }
 
+        /// <summary>
+        /// Slots of the frame being generated that the garbage collector can skip at the current position: variables
+        /// of blocks that were left, and variables that never hold a collectable reference.
+        /// </summary>
+        public List<int> UnscannedSlots()
+        {
+            Set<int> inScope = new Set<int>();
+            List<int> retired = new List<int>();
+            List<int> result = new List<int>();
+            foreach (Context context in contexts)
+            {
+                if (context.owner != currentAssembler)
+                    break;
+                foreach (Context.Entry e in context.variables.Values)
+                {
+                    inScope.Put(e.slot);
+                    TypeReference type = e.type;
+                    if (type.IsNullable)
+                        type = ((NullableTypeReference)type).Parent;
+                    DefinitionTypeReference dtr = type as DefinitionTypeReference;
+                    if ((dtr != null) && !dtr.Definition.GarbageCollectable)
+                        result.Add(e.slot);
+                }
+                if (context.implicitSlot != null)
+                    inScope.Put(context.implicitSlot.slot);
+                retired.AddRange(context.retiredSlots);
+                if (context.parentReadOnly)
+                    break;
+            }
+            foreach (int slot in retired)
+                if (!inScope.Contains(slot))
+                    result.Add(slot);
+            return result;
+        }
+
         public TypeReference ResolveSlotType(Identifier name)
         {
             return FindFirstContextContaining(name).variables[name.Data].type;
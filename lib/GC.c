@@ -1,4 +1,8 @@
 #include <pluk.h>
+#include <time.h>
+#ifndef pwin32
+#include <pthread.h>
+#endif
 
 size_t* pluk_allocateGC(size_t fieldCount, size_t additionalBytes, size_t* stackTrace);
 /* pointer to value/type pair */
@@ -6,15 +10,57 @@ void pluk_touchGC(pref* reference);
 void pluk_disposeGC(size_t* value, size_t* type);
 void pluk_fullSweepGC(size_t* stackTrace);
 
+// from Heap.c
+void* heap_allocate(size_t size);
+void* heap_allocateYoung(size_t size);
+void heap_free(void* cell);
+void heap_arena(size_t* base, size_t* size);
+size_t heap_nurseryBytes();
+void heap_attachThread();
+void heap_detachThread();
+size_t heap_bytes();
+bool heap_isYoung(void* p);
+bool heap_mark(size_t* value);
+bool heap_isMarked(size_t* value);
+void heap_remember(void* slot);
+void heap_scanRemembered(void (*visit)(size_t* cell, size_t* from, size_t* to));
+size_t heap_sweepNursery(void (*promoted)(size_t* value));
+void heap_beginSweep();
+bool heap_sweepStep(size_t pageCount, bool keepDead, size_t* freed);
+size_t heap_sweepAll(bool keepDead);
+bool heap_sweepInBackground(bool keepDead);
+bool heap_sweeperBusy();
+void heap_setMarking(bool marking);
+
+// from Mark.c
+bool mark_parallel(size_t** items, size_t count);
+
+// from pluk_base_Exception.c
+size_t* findFrameMap(void* retSite);
+
 enum mode { marking, freeing };
 
-size_t* white;
-size_t* grey;
-size_t* black;
-bool direction;
+typedef struct
+{
+  size_t** items;
+  size_t count;
+  size_t capacity;
+} gc_stack;
+
+gc_stack grey;
+gc_stack youngGrey;
 size_t allocationCount, lifeCount, threshold;
 enum mode mode;
+size_t markCycle = 1;
 size_t* fiberStacks;
+size_t nurserySize = 4 * 1024 * 1024;
+
+/*
+  state the inlined write barrier of the generated code reads, [0] start of the arena, [1] size of the arena,
+  [2] nonzero while marking. the program hands its own block to gc_registerBarrier during setup.
+*/
+size_t gcBarrierFallback[3] = { 0, 0, 1 };
+size_t* gcBarrier = gcBarrierFallback;
 
 //set through extern
 size_t* gc_globalsBegin;
@@ -23,97 +69,396 @@ size_t* gc_globalsEnd;
 bool disabled = false;
 bool forceFullGcOnAlloc = false;
 bool leakFreedMemory = false;
+// the threshold of a full collection is set once its sweep is done
+bool thresholdPending = false;
+
+/*
+  pacing, configured through the environment during setup.
+  PLUK_GC_HEAP_TARGET, bytes with an optional k, m or g suffix, is the heap size that starts a full collection, or a
+  quarter more than the heap left by the previous one if that is larger. without it a full collection starts once twice
+  as many objects are alive as after the previous one.
+  PLUK_GC_MAX_PAUSE_US bounds the time a single allocation spends on incremental work. past the trigger allocations
+  then work up to the budget instead of running a full collection, which is held back until twice the trigger.
+  after every cycle the incremental work per allocation is set so marking all live objects fits before the trigger,
+  and with a budget the nursery shrinks while minor collections take longer than it.
+*/
+#define PACE_MAX_WORK 1024
+#define PACE_MIN_NURSERY (64 * 1024)
+
+size_t gcHeapTarget = 0;
+size_t gcMaxPause = 0;
+size_t gcTrigger = 0;
+size_t paceWork = 1;
+size_t nurseryLimit;
+
+/* telemetry read through pluk.base.GC, times in microseconds */
+size_t fullCollections = 0;
+size_t minorCollections = 0;
+size_t incrementalCycles = 0;
+size_t fullPauseTotal = 0;
+size_t minorPauseTotal = 0;
+size_t maxPause = 0;
+size_t lastMinorPause = 0;
+
+/*
+  threads running pluk code. once there is more than one every collection stops the world, the collecting thread
+  waits until each of the others reached a safepoint, an allocation, or is parked in a blocking call, leaving the
+  stack trace of where it stopped. there is no incremental work then and the barrier only records stores of young
+  objects. locals are roots each thread keeps for itself, the PLUK_LOCAL_ slots.
+*/
+typedef struct gc_thread gc_thread;
+
+struct gc_thread
+{
+  size_t* stackTrace;
+  size_t* fiber; // record of the fiber the thread runs now, its [1] is the stack of whoever switched to it
+  pref locals[PLUK_LOCAL_COUNT];
+  gc_thread* next;
+};
+
+gc_thread gcMainThread;
+gc_thread* gcThreads = &gcMainThread;
+pluk_thread_local gc_thread* gcSelf = &gcMainThread;
+bool gcThreaded = false;
+size_t gcThreadCount = 1;
+// stopped at a safepoint or parked
+size_t gcStoppedCount = 0;
+volatile bool gcStopping = false;
+
+#ifdef pwin32
+#define gc_lock()
+#define gc_unlock()
+#define gc_wait()
+#define gc_broadcast()
+#else
+pthread_mutex_t gcLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t gcChanged = PTHREAD_COND_INITIALIZER;
+#define gc_lock() pthread_mutex_lock(&gcLock)
+#define gc_unlock() pthread_mutex_unlock(&gcLock)
+#define gc_wait() pthread_cond_wait(&gcChanged, &gcLock)
+#define gc_broadcast() pthread_cond_broadcast(&gcChanged)
+#endif
+
+/* PLUK_GC_TRACE other than 0 writes a line to stderr for every full collection once its sweep is done */
+bool gcTrace = false;
+size_t tracePause;
+size_t traceSweepStart;
+size_t traceSurvivors;
+
+void gc_registerBarrier(size_t* barrier)
+{
+  heap_arena(&barrier[0], &barrier[1]);
+  barrier[2] = gcBarrier[2];
+  gcBarrier = barrier;
+}
+
+size_t gcSetting(const char* name)
+{
+  char* setting = getenv(name);
+  char* end;
+  if (!setting)
+    return 0;
+  size_t value = (size_t)strtoul(setting, &end, 10);
+  if ((*end == 'k') || (*end == 'K'))
+    value <<= 10;
+  else if ((*end == 'm') || (*end == 'M'))
+    value <<= 20;
+  else if ((*end == 'g') || (*end == 'G'))
+    value <<= 30;
+  return value;
+}
+
+void gc_configure()
+{
+  gcHeapTarget = gcSetting("PLUK_GC_HEAP_TARGET");
+  gcMaxPause = gcSetting("PLUK_GC_MAX_PAUSE_US");
+  gcTrigger = gcHeapTarget;
+  nurseryLimit = nurserySize;
+  char* trace = getenv("PLUK_GC_TRACE");
+  gcTrace = trace && strcmp(trace, "0");
+}
+
+/* microseconds, only differences are used */
+size_t gcNow()
+{
+#ifdef pwin32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (size_t)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (size_t)now.tv_sec * 1000000 + (size_t)now.tv_nsec / 1000;
+#endif
+}
+
+/* whether the heap grew past slack times the trigger */
+bool overTrigger(size_t slack)
+{
+  if (gcHeapTarget)
+    return heap_bytes() > gcTrigger * slack;
+  return lifeCount > threshold * slack;
+}
+
+/* minor collections take time in proportion to the survivors, a smaller nursery keeps them within the pause budget */
+void paceNursery(size_t elapsed)
+{
+  if ((elapsed > gcMaxPause) && (nurserySize > PACE_MIN_NURSERY))
+    nurserySize /= 2;
+  else if ((elapsed < gcMaxPause / 4) && (nurserySize < nurseryLimit))
+    nurserySize *= 2;
+}
+
+void recordPause(size_t pause, size_t* total)
+{
+  *total += pause;
+  if (pause > maxPause)
+    maxPause = pause;
+}
+
+/* the sweep of the running cycle freed some objects */
+void sweptGC(size_t freed)
+{
+  if (gcThreaded)
+    __sync_fetch_and_sub(&lifeCount, freed);
+  else
+    lifeCount -= freed;
+  traceSurvivors -= freed;
+}
+
+void traceFull()
+{
+  if (!gcTrace)
+    return;
+  fprintf(stderr, "gc: full collection %lu, pause %lu us, sweep %lu us, %lu survivors, heap %lu kB\n",
+    (unsigned long)fullCollections, (unsigned long)tracePause, (unsigned long)(gcNow() - traceSweepStart),
+    (unsigned long)traceSurvivors, (unsigned long)(heap_bytes() >> 10));
+}
+
+/* called once the sweep of a cycle is done, sets the trigger and the work per allocation for the next one */
+void pace()
+{
+  if (thresholdPending)
+    traceFull();
+  else
+    incrementalCycles++;
+  // with a pause budget incremental cycles stand in for full collections
+  if (thresholdPending || gcMaxPause)
+    threshold = lifeCount * 2 + 1024;
+  thresholdPending = false;
+  if (gcHeapTarget)
+  {
+    size_t bytes = heap_bytes();
+    gcTrigger = bytes + bytes / 4;
+    if (gcTrigger < gcHeapTarget)
+      gcTrigger = gcHeapTarget;
+  }
+  if (!gcHeapTarget && !gcMaxPause)
+    return;
+  size_t headroom;
+  if (gcHeapTarget)
+  {
+    size_t bytes = heap_bytes();
+    size_t average = lifeCount ? bytes / lifeCount : 1;
+    if (average == 0)
+      average = 1;
+    headroom = (gcTrigger > bytes) ? (gcTrigger - bytes) / average : 0;
+  }
+  else
+    headroom = (threshold > lifeCount) ? threshold - lifeCount : 0;
+  paceWork = lifeCount / (headroom + 1) + 1;
+  if (paceWork > PACE_MAX_WORK)
+    paceWork = PACE_MAX_WORK;
+}
+
+void setMode(enum mode value)
+{
+  if (value == marking)
+  {
+    markCycle++;
+    if (markCycle == 0)
+      markCycle = 1;
+  }
+  mode = value;
+  // with several threads marking happens all at once while the world is stopped, an object born marked in
+  // between would not be scanned by it
+  bool incremental = (value == marking) && !gcThreaded;
+  gcBarrier[2] = incremental ? 1 : 0;
+  heap_setMarking(incremental);
+}
 
 void gc_registerFiber(size_t* fiber)
 {
+  gc_lock();
   fiber[2] = (size_t)fiberStacks;
   fiber[3] = 0;
   if (fiberStacks)
     fiberStacks[3] = (size_t)fiber;
   fiberStacks = fiber;
+  gc_unlock();
 }
 
 void gc_unregisterFiber(size_t* fiber)
 {
+  gc_lock();
   if (fiber[2]) // not the last
     ((size_t*)fiber[2])[3] = fiber[3]; // my next.prev = prev
   if (fiber[3]) // not the first
     ((size_t*)fiber[3])[2] = fiber[2]; // my prev.next = next
   else
     fiberStacks = (size_t*)fiber[2];
+  gc_unlock();
 }
 
-/* objects are 3 words larger -3[FieldCount << 1 | Color] -2 Next -1 Prev */
+pref* pluk_threadLocal(size_t index)
+{
+  return &gcSelf->locals[index];
+}
 
-void touchGC(size_t* data)
+/* holding gcLock, waits until the collection of another thread is done */
+void gc_stopped(size_t* stackTrace)
 {
-  if ((data[-3] & 1) == (direction?0:1))
+  gcSelf->stackTrace = stackTrace;
+  gcStoppedCount++;
+  gc_broadcast();
+  while (gcStopping)
+    gc_wait();
+  gcStoppedCount--;
+}
+
+void gc_safepoint(size_t* stackTrace)
+{
+  if (!gcStopping)
+    return;
+  gc_lock();
+  if (gcStopping)
+    gc_stopped(stackTrace);
+  gc_unlock();
+}
+
+/* returns once every other thread is stopped, or false after taking part in the collection of another thread */
+bool gc_stopWorld(size_t* stackTrace)
+{
+  gc_lock();
+  if (gcStopping)
   {
-    data[-3] ^= 1;
-    if (data[-2])
-      ((size_t*)data[-2])[-1] = data[-1];
-    if (data[-1])
-      ((size_t*)data[-1])[-2] = data[-2];
-    else
-      if (direction)
-        white = (size_t*)data[-2];
-      else
-        black = (size_t*)data[-2];
-    if (grey) 
-      grey[-1] = (size_t)data;
-    data[-2] = (size_t)grey;
-    data[-1] = 0;
-    grey = data;
+    gc_stopped(stackTrace);
+    gc_unlock();
+    return false;
   }
+  gcStopping = true;
+  while (gcStoppedCount + 1 < gcThreadCount)
+    gc_wait();
+  gc_unlock();
+  return true;
+}
+
+void gc_startWorld()
+{
+  gc_lock();
+  gcStopping = false;
+  gc_broadcast();
+  gc_unlock();
+}
+
+/* around a blocking call, the stack of a parked thread has to stay as it is until gc_unpark */
+void gc_park(size_t* stackTrace)
+{
+  if (!gcThreaded)
+    return;
+  gc_lock();
+  gcSelf->stackTrace = stackTrace;
+  gcStoppedCount++;
+  gc_broadcast();
+  gc_unlock();
+}
+
+void gc_unpark()
+{
+  if (!gcThreaded)
+    return;
+  gc_lock();
+  while (gcStopping)
+    gc_wait();
+  gcStoppedCount--;
+  gc_unlock();
+}
+
+size_t* gc_enterFiber(size_t* fiber)
+{
+  size_t* previous = gcSelf->fiber;
+  gcSelf->fiber = fiber;
+  return previous;
+}
+
+bool fiberRunning(size_t* fiber)
+{
+  gc_thread* thread;
+  for (thread = gcThreads; thread; thread = thread->next)
+    if (thread->fiber == fiber)
+      return true;
+  return false;
+}
+
+/* objects are 1 word larger -1[FieldCount << 1 | 1], the mark bits live in the page bitmaps of the heap */
+/* an object is grey while it is marked and on the grey stack, black once marked and scanned */
+
+void pushGC(gc_stack* stack, size_t* data)
+{
+  if (stack->count == stack->capacity)
+  {
+    stack->capacity = stack->capacity ? stack->capacity * 2 : 1024;
+    stack->items = realloc(stack->items, stack->capacity * sizeof(size_t*));
+    if (!stack->items)
+      abort();
+  }
+  stack->items[stack->count++] = data;
+}
+
+void touchGC(size_t* data)
+{
+  if (heap_mark(data))
+    pushGC(&grey, data);
+}
+
+/* pointer to value/type pair, young objects are left to the minor collections */
+void greyGC(pref* reference)
+{
+  size_t* t = reference->type;
+  if ((t == 0) || (t[0] == 0))
+    return;
+  size_t* data = reference->value;
+  if (data == 0)
+    return;
+  if (heap_isYoung(data))
+    return;
+  touchGC(data);
 }
 
 /* pointer to value/type pair */
+/* the write barrier, besides greying it records stores of young objects in the remembered set */
+/* outside of marking nothing is greyed, a mark bit set while freeing would outlive the sweep of its page */
+/* stores into young objects need neither, the minor collection scans them all */
 void pluk_touchGC(pref* reference)
 {
   if (reference == 0)
     return;
+  if (heap_isYoung(reference))
+    return;
   size_t* t = reference->type;
   if ((t == 0) || (t[0] == 0))
     return;
   size_t* data = reference->value;
   if (data == 0)
     return;
-  //inline of touchGC
-  if ((data[-3] & 1) == (direction?0:1))
+  if (heap_isYoung(data))
   {
-    data[-3] ^= 1;
-    if (data[-2])
-      ((size_t*)data[-2])[-1] = data[-1];
-    if (data[-1])
-      ((size_t*)data[-1])[-2] = data[-2];
-    else
-      if (direction)
-        white = (size_t*)data[-2];
-      else
-        black = (size_t*)data[-2];
-    if (grey) 
-      grey[-1] = (size_t)data;
-    data[-2] = (size_t)grey;
-    data[-1] = 0;
-    grey = data;
+    heap_remember(reference);
+    return;
   }
-}
-
-void removeAndFree(size_t* data)
-{
-  if (black == data)
-    black = (size_t*)data[-2];
-  if (white == data)
-    white = (size_t*)data[-2];
-  if (grey == data)
-    grey = (size_t*)data[-2];
-  if (data[-2])
-    ((size_t*)data[-2])[-1] = data[-1];
-  if (data[-1])
-    ((size_t*)data[-1])[-2] = data[-2];
-  if (!leakFreedMemory)
-    free(&data[-3]);
-  lifeCount--;
+  if ((mode == marking) && !gcThreaded)
+    touchGC(data);
 }
 
 void pluk_disposeGC(size_t* value, size_t* valueType)
@@ -124,46 +469,51 @@ void pluk_disposeGC(size_t* value, size_t* valueType)
     return;
   if (valueType[0] == 0)
     return;
-  removeAndFree(value);
+  // the nursery is reclaimed by page
+  if (heap_isYoung(value))
+    return;
+  // the running sweep owns the mark bits, it might be clearing them on the sweeper thread
+  if (mode == freeing)
+    return;
+  // marked objects might still be on the grey stack, the sweep takes care of them
+  if (heap_isMarked(value))
+    return;
+  if (!leakFreedMemory)
+    heap_free(&value[-1]);
+  if (gcThreaded)
+    __sync_fetch_and_sub(&lifeCount, 1);
+  else
+    lifeCount--;
 }
 
 void makeAlive(size_t* data)
 {
-  size_t fieldCount = data[-3] >> 1;
-  if (direction)
-  {
-    data[-3] = (fieldCount << 1) | 1;
-    if (black)
-      black[-1] = (size_t)data;
-    data[-2] = (size_t)black;
-    data[-1] = 0;
-    black = data;
-    if (white == data)
-      white = 0;
-  }  
-  else
-  {
-    data[-3] = fieldCount << 1;
-    if (white)
-      white[-1] = (size_t)data;
-    data[-2] = (size_t)white;
-    data[-1] = 0;
-    white = data;
-    if (black == data)
-      black = 0;    
-  }
+  size_t fieldCount = data[-1] >> 1;
   while (fieldCount--)
   {
-    pluk_touchGC((pref*)&data[fieldCount << 1]);
+    greyGC((pref*)&data[fieldCount << 1]);
   }
 }
 
-void markLocalStack(size_t* stackTrace)
+void drainGrey()
+{
+  while (grey.count)
+    makeAlive(grey.items[--grey.count]);
+}
+
+/*
+  the region between two frames holds the outgoing arguments and temporaries of the calling function followed
+  by its variables. the frame map of the call site (see findFrameMap) names the variables that are out of scope
+  or never hold a collectable reference, those are left alone. regions spanning several frames are scanned whole.
+*/
+void markLocalStack(size_t* stackTrace, void (*touch)(pref*))
 {
   while (stackTrace)
   {
     pref* cursor;
+    size_t* map;
     cursor = (pref*)&stackTrace[2];
+    map = findFrameMap((void*)stackTrace[1]);
     stackTrace = (size_t*)stackTrace[0];
     while (true)
     {
@@ -171,272 +521,457 @@ void markLocalStack(size_t* stackTrace)
         return;
       if (stackTrace[1])
         break;
+      map = 0;
       stackTrace = (size_t*)stackTrace[0];
     }
-    while (((size_t)cursor) < ((size_t)stackTrace))
+    pref* variables = (pref*)stackTrace;
+    if (map)
     {
-      pluk_touchGC(cursor);
+      variables = (pref*)stackTrace - map[0];
+      if (variables < cursor)
+      {
+        map = 0;
+        variables = (pref*)stackTrace;
+      }
+    }
+    while (cursor < variables)
+    {
+      touch(cursor);
       cursor = &cursor[1];
     }
+    if (map)
+    {
+      size_t bits = 8 * sizeof(size_t);
+      size_t i;
+      for (i = 0; i < map[0]; i++)
+        if (!(map[1 + i / bits] & ((size_t)1 << (i % bits))))
+          touch((pref*)stackTrace - (i + 1));
+    }
   }
 }
 
-// if scanall is false only the current stack is scanned unless that results in no new elements on the gray list
-// otherwise the fiberstacks are also scanned
-void markStack(size_t* stackTrace, bool scanAll)
+/*
+  a suspended stack does not change until it is switched to, every switch clears the stamps of the record that takes
+  the stack being left. [8] holds the mark cycle it was last scanned in, [9] is set once a minor collection saw it,
+  the nursery is empty after that. the records of the running fibers are never stamped, the stack it holds belongs to the
+  side that switched to it and that side may be unwound and rewound without another switch through this record.
+*/
+void markOtherRoots(void (*touch)(pref*), size_t stampIndex, size_t stamp)
 {
-  markLocalStack(stackTrace);
-  if (scanAll || (grey == 0))
+  size_t* fs = fiberStacks;
+  gc_thread* thread;
+  size_t i;
+  for (thread = gcThreads; thread; thread = thread->next)
   {
-    size_t* fs = fiberStacks;
-    while (fs)
+    if (thread != gcSelf)
+      markLocalStack(thread->stackTrace, touch);
+    for (i = 0; i < PLUK_LOCAL_COUNT; i++)
+      touch(&thread->locals[i]);
+  }
+  while (fs)
+  {
+    bool running = fiberRunning(fs);
+    if (running || (fs[stampIndex] != stamp))
     {
       size_t* ebp = (size_t*)fs[1];
-      markLocalStack(ebp);
-      fs = (size_t*)fs[2];
-    }
-    
-    pref* cursor = (pref*)gc_globalsBegin;
-    while (cursor < (pref*)gc_globalsEnd)
-    {
-      pluk_touchGC(cursor);
-      cursor = &cursor[1];
+      markLocalStack(ebp, touch);
+      if (!running)
+        fs[stampIndex] = stamp;
     }
+    fs = (size_t*)fs[2];
+  }
+  
+  pref* cursor = (pref*)gc_globalsBegin;
+  while (cursor < (pref*)gc_globalsEnd)
+  {
+    touch(cursor);
+    cursor = &cursor[1];
   }
 }
 
-void pluk_fullSweepGC(size_t* stackTrace)
+// if scanall is false only the current stack is scanned unless that results in no new elements on the gray list
+// otherwise the fiberstacks are also scanned
+void markStack(size_t* stackTrace, bool scanAll)
+{
+  markLocalStack(stackTrace, greyGC);
+  if (scanAll || (grey.count == 0))
+    markOtherRoots(greyGC, 8, markCycle);
+}
+
+void touchYoung(pref* reference)
+{
+  size_t* t = reference->type;
+  if ((t == 0) || (t[0] == 0))
+    return;
+  size_t* data = reference->value;
+  if (data == 0)
+    return;
+  if (!heap_isYoung(data))
+    return;
+  if (heap_mark(data))
+    pushGC(&youngGrey, data);
+}
+
+void touchRemembered(size_t* cell, size_t* from, size_t* to)
+{
+  size_t* data = &cell[1];
+  size_t fieldCount = data[-1] >> 1;
+  size_t first = 0;
+  if (to <= data)
+    return;
+  // the fields that start on the card
+  if (from > data)
+    first = ((size_t)(from - data) + 1) >> 1;
+  if (to < &data[fieldCount << 1])
+    fieldCount = ((size_t)(to - data) + 1) >> 1;
+  while (first < fieldCount)
+  {
+    touchYoung((pref*)&data[first << 1]);
+    first++;
+  }
+}
+
+// survivors are promoted into the old generation, grey when a marking phase is running so the
+// old objects only they refer to get marked
+void promote(size_t* data)
+{
+  if (mode == marking)
+    touchGC(data);
+}
+
+// marks the nursery from all roots and the remembered set, afterwards the nursery is empty
+void minorCollect(size_t* stackTrace)
 {
   if (disabled)
     return;
-  mode = marking;
-  markStack(stackTrace, true);
-  while (grey)
+  size_t start = gcNow();
+  markLocalStack(stackTrace, touchYoung);
+  markOtherRoots(touchYoung, 9, 1);
+  heap_scanRemembered(touchRemembered);
+  while (youngGrey.count)
   {
-    size_t* cursor = grey;
-    grey = (size_t*)grey[-2];
-    if (grey)
-      grey[-1] = 0;
-    makeAlive(cursor);
+    size_t* data = youngGrey.items[--youngGrey.count];
+    size_t fieldCount = data[-1] >> 1;
+    while (fieldCount--)
+      touchYoung((pref*)&data[fieldCount << 1]);
   }
-  if (direction)
+  lifeCount -= heap_sweepNursery(promote);
+  minorCollections++;
+  lastMinorPause = gcNow() - start;
+  recordPause(lastMinorPause, &minorPauseTotal);
+}
+
+void fullCollect(size_t* stackTrace)
+{
+  if (disabled)
+    return;
+  // finish the sweep of the running cycle, the marking that follows needs clean bitmaps
+  if (mode == freeing)
   {
-    while (white)
-    {
-      size_t* cursor = white;
-      white = (size_t*)white[-2];
-      if (white)
-        white[-1] = 0;
-      if (!leakFreedMemory)
-        free(&(cursor[-3]));
-      lifeCount--;
-    }
+    sweptGC(heap_sweepAll(leakFreedMemory));
+    pace();
   }
+  size_t start = gcNow();
+  fullCollections++;
+  setMode(marking);
+  minorCollect(stackTrace);
+  markStack(stackTrace, true);
+  if (mark_parallel(grey.items, grey.count))
+    grey.count = 0;
   else
+    drainGrey();
+  heap_beginSweep();
+  thresholdPending = true;
+  traceSurvivors = lifeCount;
+  traceSweepStart = gcNow();
+  if (heap_sweepInBackground(leakFreedMemory))
   {
-    while (black)
-    {
-      size_t* cursor = black;
-      black = (size_t*)black[-2];
-      if (black)
-        black[-1] = 0;
-      if (!leakFreedMemory)
-        free(&(cursor[-3]));
-      lifeCount--;
-    }
+    tracePause = gcNow() - start;
+    recordPause(tracePause, &fullPauseTotal);
+    setMode(freeing);
+    // the garbage is still counted, keep the next full collection off until the sweep is done
+    threshold = lifeCount * 2 + 1024;
+    if (gcTrigger < heap_bytes() * 2)
+      gcTrigger = heap_bytes() * 2;
+  }
+  else
+  {
+    sweptGC(heap_sweepAll(leakFreedMemory));
+    tracePause = gcNow() - start;
+    recordPause(tracePause, &fullPauseTotal);
+    // the sweep cleared every mark, the stacks stamped above have to be scanned again by the next marking
+    setMode(marking);
+    pace();
   }
-  direction = !direction;
 }
 
-void process(size_t* stackTrace)
+/* frees the garbage of the running cycle right away, for allocations that can not wait for the sweeper */
+void finishSweep()
 {
-  if (disabled)
+  if (mode != freeing)
     return;
-  if (mode == marking)
+  sweptGC(heap_sweepAll(leakFreedMemory));
+  pace();
+  setMode(marking);
+}
+
+void pluk_fullSweepGC(size_t* stackTrace)
+{
+  if (!gcThreaded)
   {
-    if (grey)
-    {
-      size_t* cursor = grey;
-      grey = (size_t*)grey[-2];
-      if (grey)
-        grey[-1] = 0;
-      makeAlive(cursor);
-    }
-    else
-    {
-      if (stackTrace)
-      {
-        markStack(stackTrace, false);
-        if (grey == 0)
-          mode = freeing;
-      }
-    }
+    fullCollect(stackTrace);
+    return;
+  }
+  while (!gc_stopWorld(stackTrace))
+    ;
+  fullCollect(stackTrace);
+  gc_startWorld();
+}
+
+/* a full collection with its sweep done, for allocations the heap could not satisfy */
+void collectAll(size_t* stackTrace)
+{
+  if (!gcThreaded)
+  {
+    fullCollect(stackTrace);
+    finishSweep();
+    return;
+  }
+  while (!gc_stopWorld(stackTrace))
+    ;
+  fullCollect(stackTrace);
+  finishSweep();
+  gc_startWorld();
+}
+
+/* the collections of an allocation while several threads run, the world is only stopped when one is due */
+void collectThreaded(size_t* stackTrace)
+{
+  gc_safepoint(stackTrace);
+  // a sweep the sweeper is done with is finished without stopping anyone
+  if ((mode == freeing) && !heap_sweeperBusy())
+  {
+    gc_lock();
+    if (!gcStopping)
+      finishSweep();
+    gc_unlock();
   }
+  bool full = overTrigger(1) || forceFullGcOnAlloc;
+  if (!full && (heap_nurseryBytes() < nurserySize))
+    return;
+  // another thread collected meanwhile
+  if (!gc_stopWorld(stackTrace))
+    return;
+  if (full)
+    fullCollect(stackTrace);
   else
   {
-    if (direction)
-    {
-      if (white)
-      {
-        size_t* cursor = white;
-        white = (size_t*)white[-2];
-        if (white)
-          white[-1] = 0;
-        if (!leakFreedMemory)
-          free(&(cursor[-3]));
-        lifeCount--;
-      }
-      else
-      {
-        direction = ! direction;
-        mode = marking;
-      }
-    }
+    minorCollect(stackTrace);
+    if (gcMaxPause)
+      paceNursery(lastMinorPause);
+  }
+  gc_startWorld();
+}
+
+/*
+  registers a thread that is about to start, parked until it calls gc_enterThread, keeping host alive. the first
+  one ends the incremental cycle with a full collection, the stores of the other threads would not be seen by it.
+*/
+void* gc_addThread(pref host, size_t* stackTrace)
+{
+  if (!gcThreaded)
+  {
+    // the frame maps are built on first use, which must not race
+    findFrameMap((void*)1);
+    fullCollect(stackTrace);
+    gcThreaded = true;
+    gcBarrier[2] = 0;
+    heap_setMarking(false);
+  }
+  gc_thread* thread = calloc(1, sizeof(gc_thread));
+  if (!thread)
+    abort();
+  thread->locals[PLUK_LOCAL_HOST] = host;
+  gc_lock();
+  while (gcStopping)
+    gc_stopped(stackTrace);
+  thread->next = gcThreads;
+  gcThreads = thread;
+  gcThreadCount++;
+  gcStoppedCount++;
+  gc_unlock();
+  return thread;
+}
+
+/* unregisters a parked thread */
+void gc_dropThread(void* thread)
+{
+  gc_thread** link = &gcThreads;
+  gc_lock();
+  while (*link != thread)
+    link = &(*link)->next;
+  *link = ((gc_thread*)thread)->next;
+  gcThreadCount--;
+  gcStoppedCount--;
+  gc_broadcast();
+  gc_unlock();
+  free(thread);
+}
+
+/* called first thing on the new thread */
+void gc_enterThread(void* thread)
+{
+  gcSelf = thread;
+  heap_attachThread();
+  gc_unpark();
+}
+
+/* called last thing on a thread, once it has no more pluk code to run */
+void gc_leaveThread()
+{
+  gc_thread* thread = gcSelf;
+  heap_detachThread();
+  gc_park(0);
+  gcSelf = &gcMainThread;
+  gc_dropThread(thread);
+}
+
+/* a unit of incremental work, returns false when the cycle moved to another phase or has to wait for the sweeper */
+bool processStep(size_t* stackTrace)
+{
+  if (mode == marking)
+  {
+    if (grey.count)
+      makeAlive(grey.items[--grey.count]);
     else
     {
-      if (black)
-      {
-        size_t* cursor = black;
-        black = (size_t*)black[-2];
-        if (black)
-          black[-1] = 0;
-        if (!leakFreedMemory)
-          free(&(cursor[-3]));
-        lifeCount--;
-      }
-      else
+      if (!stackTrace)
+        return false;
+      markStack(stackTrace, false);
+      if (grey.count == 0)
       {
-        direction = ! direction;
-        mode = marking;
+        // young objects can be the last holders of old ones, empty the nursery before freeing
+        minorCollect(stackTrace);
+        drainGrey();
+        setMode(freeing);
+        heap_beginSweep();
+        heap_sweepInBackground(leakFreedMemory);
+        return false;
       }
     }
+    return true;
+  }
+  if (heap_sweeperBusy())
+    return false;
+  size_t freed = 0;
+  bool done = heap_sweepStep(1, leakFreedMemory, &freed);
+  sweptGC(freed);
+  if (done)
+  {
+    pace();
+    setMode(marking);
+    return false;
   }
+  return true;
 }
 
-void fullProcess()
+void process(size_t* stackTrace)
 {
   if (disabled)
     return;
-  while(true)
+  size_t work = paceWork;
+  size_t done = 0;
+  size_t start = 0;
+  // past the trigger the pause budget takes the place of a full collection
+  if (gcMaxPause && overTrigger(1))
+    work = (size_t)-1;
+  while (done < work)
   {
-    if (mode == marking)
+    if (!processStep(stackTrace))
+      return;
+    done++;
+    // the clock is only read once there is some work to time, most allocations do a few units
+    if (gcMaxPause && ((done & 63) == 0))
     {
-      if (grey)
-      {
-        size_t* cursor = grey;
-        grey = (size_t*)grey[-2];
-        if (grey)
-          grey[-1] = 0;
-        makeAlive(cursor);
-      }
-      else
-      {
+      if (!start)
+        start = gcNow();
+      else if (gcNow() - start >= gcMaxPause)
         return;
-      }
-    }
-    else
-    {
-      if (direction)
-      {
-        if (white)
-        {
-          size_t* cursor = white;
-          white = (size_t*)white[-2];
-          if (white)
-            white[-1] = 0;
-          if (!leakFreedMemory)
-            free(&(cursor[-3]));
-          lifeCount--;
-        }
-        else
-        {
-          direction = ! direction;
-          mode = marking;
-        }
-      }
-      else
-      {
-        if (black)
-        {
-          size_t* cursor = black;
-          black = (size_t*)black[-2];
-          if (black)
-            black[-1] = 0;
-          if (!leakFreedMemory)
-            free(&(cursor[-3]));
-          lifeCount--;
-        }
-        else
-        {
-          direction = ! direction;
-          mode = marking;
-        }
-      }
     }
   }
 }
 
+void fullProcess()
+{
+  // without a stack trace the other threads can not be stopped
+  if (disabled || gcThreaded)
+    return;
+  if (mode == marking)
+  {
+    drainGrey();
+    return;
+  }
+  sweptGC(heap_sweepAll(leakFreedMemory));
+  pace();
+  setMode(marking);
+}
+
 size_t* pluk_allocateGC(size_t fieldCount, size_t additionalBytes, size_t* stackTrace)
 {
   size_t c;
   size_t* result;
   if (!disabled)
   {
-    if (stackTrace && ((lifeCount > threshold) || forceFullGcOnAlloc))
+    if (gcThreaded)
     {
-      pluk_fullSweepGC(stackTrace);
-      threshold = lifeCount * 2 + 1024;
+      if (stackTrace)
+        collectThreaded(stackTrace);
     }
+    else if (stackTrace && (overTrigger(gcMaxPause ? 2 : 1) || forceFullGcOnAlloc))
+      pluk_fullSweepGC(stackTrace);
     else
+    {
+      if (stackTrace && (heap_nurseryBytes() >= nurserySize))
+      {
+        minorCollect(stackTrace);
+        if (gcMaxPause)
+          paceNursery(lastMinorPause);
+      }
       process(stackTrace);
+    }
   }
-  c = (fieldCount * 2 + 3) * (size_t)sizeof(size_t) + additionalBytes;
+  c = (fieldCount * 2 + 1) * (size_t)sizeof(size_t) + additionalBytes;
   c = ((c+(size_t)sizeof(size_t)-1) >> ((sizeof(size_t)==8)?3:2)) << ((sizeof(size_t)==8)?3:2);
-  result = calloc(c, 1);
+  result = heap_allocateYoung(c);
   if (!result)
   {
     if (stackTrace)
-    {
-      pluk_fullSweepGC(stackTrace);
-      threshold = lifeCount * 2 + 1024;
-    }
+      collectAll(stackTrace);
     else
       fullProcess();
-    result = calloc(c, 1);
+    result = heap_allocate(c);
     if (!result)
     {
       if (stackTrace)
-      {
-        pluk_fullSweepGC(stackTrace);
-        threshold = lifeCount * 2 + 1024;
-      }
+        collectAll(stackTrace);
       else
         fullProcess();
-      result = calloc(c, 1);
+      result = heap_allocate(c);
       if (!result)
         abort();
     }
   }
-  lifeCount++;
-  allocationCount++;  
-  result = &(result[3]);
-  if (direction)
+  if (gcThreaded)
   {
-    result[-3] = (fieldCount << 1) + 1;
-    if (black)
-      black[-1] = (size_t)result;
-    result[-2] = (size_t)black;
-    result[-1] = 0;
-    black = result;
+    __sync_fetch_and_add(&lifeCount, 1);
+    __sync_fetch_and_add(&allocationCount, 1);
   }
   else
   {
-    result[-3] = fieldCount << 1;
-    if (white)
-      white[-1] = (size_t)result;
-    result[-2] = (size_t)white;
-    result[-1] = 0;
-    white = result;
+    lifeCount++;
+    allocationCount++;
   }
+  result = &(result[1]);
+  result[-1] = (fieldCount << 1) | 1;
   return result;
 }
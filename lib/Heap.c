@@ -0,0 +1,1136 @@
+#define _DEFAULT_SOURCE
+#include <pluk.h>
+
+#ifdef pwin32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#endif
+
+/*
+  Size-class segregated heap backing the garbage collector.
+
+  A single contiguous arena is reserved up front and handed out in pages of
+  HEAP_PAGE_SIZE bytes, every page aligned on its own size so the page header
+  of any cell is found by masking the cell address.
+  Small requests are rounded up to one of the size classes, each class owns a
+  list of pages that still have room, every page hands out cells first by
+  bumping through never used memory and after that from its own free list.
+  Pages that become empty are returned to the run list, neighbouring runs are
+  merged again.
+  Requests larger than the biggest class, big arrays and fiber stacks, live
+  in the large object space, the upper half of the reservation, so they
+  never break up the runs of the small pages. Each gets a range of whole
+  pages to itself, the header page first, taken first fit from the free
+  ranges, which are kept outside of the space in address order. The memory
+  of a freed large object is handed back to the system right away while its
+  range stays reserved, so the space always hands out zeroed memory.
+  The first word of a free cell is always zero, the free list link lives in
+  the second word, so a walk over the cells of a page can tell them apart
+  from live objects.
+
+  Mark bits are kept on the side, a bitmap at the start of every page holds
+  one bit per granule of HEAP_GRANULE bytes, an object is marked through the
+  granule its first field lives in. Cells are atleast a granule apart so no
+  two objects share a bit. Marking never writes to the objects themselves and
+  sweeping is a linear scan over the bitmap and the cells of each page,
+  rebuilding its free list.
+  Every page remembers the epoch it was last swept in, a sweep moves the
+  epoch on once all pages are done. Old objects allocated on a page that is
+  still waiting for the sweep are born marked so the sweep keeps them.
+
+  Young objects are bump allocated into nursery pages, one per size class
+  and thread, that are never reused for old objects until a minor collection
+  has swept them. Nursery pages without survivors are recycled as a whole, pages with
+  survivors are promoted in place to ordinary pages of their class.
+  Stores into old objects are recorded on a card table covering the arena,
+  the dirty cards are the remembered set for minor collections.
+
+  Sweeps can run on a sweeper thread while the program continues. Everything
+  the sweeper touches, the old pages, their lists and the free runs, is
+  guarded by heapLock, which the program only takes on its slow paths: new
+  pages, large and old allocations, frees, the first store dirtying a card
+  and minor collections. Bump allocation in the nursery never needs it, the
+  sweeper leaves young pages alone and other threads have nurseries of their
+  own. The sweeper works in batches of HEAP_SWEEP_BATCH pages and lets go
+  of the lock in between. PLUK_GC_BACKGROUND_SWEEP=0 keeps sweeping on the
+  program thread, as does a platform without pthreads.
+*/
+
+#define HEAP_PAGE_SHIFT 16
+#define HEAP_PAGE_SIZE ((size_t)1 << HEAP_PAGE_SHIFT)
+#define HEAP_COMMIT_SIZE (16 * HEAP_PAGE_SIZE)
+#define HEAP_MAX_SMALL 8192
+#define HEAP_LARGE ((size_t)-1)
+#define HEAP_CLASS_COUNT 39
+#define HEAP_CARD_SHIFT 10
+#define HEAP_CARD_SIZE ((size_t)1 << HEAP_CARD_SHIFT)
+#define HEAP_GRANULE (2 * sizeof(size_t))
+#define HEAP_WORD_BITS (8 * sizeof(size_t))
+#define HEAP_MARK_WORDS (HEAP_PAGE_SIZE / HEAP_GRANULE / HEAP_WORD_BITS)
+
+#ifdef pluk64
+#define HEAP_ARENA_SIZE ((size_t)1 << 36)
+#else
+#define HEAP_ARENA_SIZE ((size_t)1 << 30)
+#endif
+#define HEAP_ARENA_MINIMUM ((size_t)1 << 26)
+#define HEAP_SWEEP_BATCH 8
+
+typedef struct heap_page heap_page;
+
+/* generated code tests marks and young inline as part of the write barrier, keep them first */
+struct heap_page
+{
+  size_t marks[HEAP_MARK_WORDS];
+  bool young;
+  heap_page* next;
+  heap_page* prev;
+  size_t pageCount;
+  size_t sizeClass;
+  size_t cellSize;
+  size_t liveCount;
+  size_t* freeList;
+  unsigned char* bump;
+  unsigned char* limit;
+  size_t epoch;
+  bool listed;
+};
+
+#define HEAP_FIRST_CELL ((sizeof(heap_page) + 15) & ~(size_t)15)
+
+typedef struct
+{
+  size_t cellSize;
+  heap_page* pages;
+} heap_class;
+
+/* the nursery pages a thread bumps through, every thread allocating young objects has its own */
+typedef struct heap_nursery heap_nursery;
+
+struct heap_nursery
+{
+  heap_page* pages[HEAP_CLASS_COUNT];
+  size_t bytes;
+  heap_nursery* next;
+};
+
+heap_class heapClasses[HEAP_CLASS_COUNT];
+size_t heapClassCount;
+unsigned char heapClassLookup[(HEAP_MAX_SMALL >> 3) + 1];
+
+unsigned char* arenaBase;
+unsigned char* arenaEnd;
+unsigned char* arenaTop;
+unsigned char* arenaCommitted;
+heap_page* freeRuns;
+heap_page** pageMap;
+
+typedef struct heap_range heap_range;
+
+struct heap_range
+{
+  unsigned char* start;
+  size_t size;
+  heap_range* next;
+};
+
+unsigned char* largeBase;
+unsigned char* largeTop;
+unsigned char* largeCommitted;
+heap_range* largeRanges;
+
+// the filled nursery pages of all threads
+heap_page* nurseryPages;
+heap_nursery heapMainNursery;
+heap_nursery* heapNurseries = &heapMainNursery;
+pluk_thread_local heap_nursery* heapOwnNursery = &heapMainNursery;
+
+unsigned char* heapCards;
+size_t* dirtyCards;
+size_t dirtyCount;
+size_t dirtyCapacity;
+
+bool heapInitialized = false;
+
+size_t heapPageCount;
+
+size_t heapEpoch;
+volatile bool heapSweeping;
+// set by the collector while it marks, objects born then count as reached. it starts out marking
+bool heapMarking = true;
+size_t sweepCursor;
+
+bool sweeperConfigured = false;
+bool sweeperRunning = false;
+bool sweeperKeepDead;
+size_t sweeperFreed;
+
+#ifdef pwin32
+#define heap_lock()
+#define heap_unlock()
+#else
+pthread_mutex_t heapLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t sweeperWake = PTHREAD_COND_INITIALIZER;
+#define heap_lock() pthread_mutex_lock(&heapLock)
+#define heap_unlock() pthread_mutex_unlock(&heapLock)
+#endif
+
+void* heap_reserveTable(size_t size)
+{
+#ifdef pwin32
+  void* result = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (!result)
+    abort();
+#else
+  void* result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (result == MAP_FAILED)
+    abort();
+#endif
+  return result;
+}
+
+void heap_init()
+{
+  size_t size = 16;
+  size_t c = 0;
+  size_t s;
+  // the growth steps rarely land on HEAP_MAX_SMALL itself, it is always the last class
+  while (true)
+  {
+    if (size > HEAP_MAX_SMALL)
+      size = HEAP_MAX_SMALL;
+    heapClasses[c].cellSize = size;
+    heapClasses[c].pages = 0;
+    c++;
+    if ((size == HEAP_MAX_SMALL) || (c == HEAP_CLASS_COUNT))
+      break;
+    if (size < 128)
+      size += 8;
+    else
+      size += (size >> 2) & ~(size_t)7;
+  }
+  if (size != HEAP_MAX_SMALL)
+    abort();
+  heapClassCount = c;
+  c = 0;
+  for (s = 0; s <= (HEAP_MAX_SMALL >> 3); ++s)
+  {
+    while ((c + 1 < heapClassCount) && (heapClasses[c].cellSize < (s << 3)))
+      c++;
+    heapClassLookup[s] = (unsigned char)c;
+  }
+
+  size = HEAP_ARENA_SIZE;
+  while (true)
+  {
+#ifdef pwin32
+    arenaBase = VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (arenaBase)
+      break;
+#else
+    arenaBase = mmap(NULL, size + HEAP_PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arenaBase != MAP_FAILED)
+      break;
+#endif
+    size >>= 1;
+    if (size < HEAP_ARENA_MINIMUM)
+      abort();
+  }
+  // align the arena on the page size, the reservation has a page to spare for this
+  arenaBase = (unsigned char*)(((size_t)arenaBase + HEAP_PAGE_SIZE - 1) & ~(HEAP_PAGE_SIZE - 1));
+  arenaEnd = arenaBase + size;
+  arenaTop = arenaBase;
+  arenaCommitted = arenaBase;
+  freeRuns = 0;
+  largeBase = arenaBase + size / 2;
+  largeTop = largeBase;
+  largeCommitted = largeBase;
+  largeRanges = 0;
+  heapPageCount = 0;
+  heapEpoch = 1;
+  heapSweeping = false;
+  // both tables are only touched where the arena is in use, untouched parts cost no memory
+  pageMap = heap_reserveTable((size >> HEAP_PAGE_SHIFT) * sizeof(heap_page*));
+  heapCards = heap_reserveTable(size >> HEAP_CARD_SHIFT);
+  nurseryPages = 0;
+  dirtyCount = 0;
+  dirtyCapacity = 1024;
+  dirtyCards = malloc(dirtyCapacity * sizeof(size_t));
+  if (!dirtyCards)
+    abort();
+  heapInitialized = true;
+}
+
+/* moves the committed end of a space up to end, limit is the end of the space */
+bool heap_commit(unsigned char** committed, unsigned char* end, unsigned char* limit)
+{
+  if (end <= *committed)
+    return true;
+  size_t size = ((size_t)(end - *committed) + HEAP_COMMIT_SIZE - 1) & ~(HEAP_COMMIT_SIZE - 1);
+  if (size > (size_t)(limit - *committed))
+    size = (size_t)(limit - *committed);
+#ifdef pwin32
+  if (!VirtualAlloc(*committed, size, MEM_COMMIT, PAGE_READWRITE))
+    return false;
+#else
+  if (mprotect(*committed, size, PROT_READ | PROT_WRITE))
+    return false;
+#endif
+  *committed += size;
+  return true;
+}
+
+void heap_mapRun(heap_page* run, size_t pageCount, heap_page* page)
+{
+  heap_page** entry = &pageMap[((unsigned char*)run - arenaBase) >> HEAP_PAGE_SHIFT];
+  while (pageCount--)
+    *(entry++) = page;
+}
+
+/* takes a run of pages, first fit from the free runs, otherwise from the untouched end of the arena */
+heap_page* heap_takeRun(size_t pageCount)
+{
+  heap_page** link = &freeRuns;
+  heap_page* run;
+  while (*link)
+  {
+    run = *link;
+    if (run->pageCount >= pageCount)
+    {
+      if (run->pageCount > pageCount)
+      {
+        heap_page* rest = (heap_page*)((unsigned char*)run + (pageCount << HEAP_PAGE_SHIFT));
+        rest->next = run->next;
+        rest->pageCount = run->pageCount - pageCount;
+        *link = rest;
+      }
+      else
+        *link = run->next;
+      heapPageCount += pageCount;
+      heap_mapRun(run, pageCount, run);
+      return run;
+    }
+    link = &run->next;
+  }
+  size_t size = pageCount << HEAP_PAGE_SHIFT;
+  if (size > (size_t)(largeBase - arenaTop))
+    return 0;
+  if (!heap_commit(&arenaCommitted, arenaTop + size, largeBase))
+    return 0;
+  run = (heap_page*)arenaTop;
+  arenaTop += size;
+  heapPageCount += pageCount;
+  heap_mapRun(run, pageCount, run);
+  return run;
+}
+
+/* returns a run of pages, the free runs are kept in address order so neighbours can be merged */
+void heap_releaseRun(heap_page* run, size_t pageCount)
+{
+  heap_page* prev = 0;
+  heap_page* next = freeRuns;
+  heap_mapRun(run, pageCount, 0);
+  while (next && (next < run))
+  {
+    prev = next;
+    next = next->next;
+  }
+  run->pageCount = pageCount;
+  run->next = next;
+  if (next && ((unsigned char*)run + (run->pageCount << HEAP_PAGE_SHIFT) == (unsigned char*)next))
+  {
+    run->pageCount += next->pageCount;
+    run->next = next->next;
+  }
+  if (prev && ((unsigned char*)prev + (prev->pageCount << HEAP_PAGE_SHIFT) == (unsigned char*)run))
+  {
+    prev->pageCount += run->pageCount;
+    prev->next = run->next;
+  }
+  else if (prev)
+    prev->next = run;
+  else
+    freeRuns = run;
+  heapPageCount -= pageCount;
+}
+
+void heap_link(heap_class* cls, heap_page* page)
+{
+  page->prev = 0;
+  page->next = cls->pages;
+  if (cls->pages)
+    cls->pages->prev = page;
+  cls->pages = page;
+  page->listed = true;
+}
+
+void heap_unlink(heap_class* cls, heap_page* page)
+{
+  if (page->next)
+    page->next->prev = page->prev;
+  if (page->prev)
+    page->prev->next = page->next;
+  else
+    cls->pages = page->next;
+  page->next = 0;
+  page->prev = 0;
+  page->listed = false;
+}
+
+/* the epoch pages are born in, during a sweep they count as swept, otherwise they wait for the next one */
+size_t heap_currentEpoch()
+{
+  return heapSweeping ? heapEpoch : heapEpoch - 1;
+}
+
+heap_page* heap_newPage(size_t c)
+{
+  heap_page* page = heap_takeRun(1);
+  if (!page)
+    return 0;
+  memset(page->marks, 0, sizeof(page->marks));
+  page->next = 0;
+  page->prev = 0;
+  page->pageCount = 1;
+  page->sizeClass = c;
+  page->cellSize = heapClasses[c].cellSize;
+  page->liveCount = 0;
+  page->freeList = 0;
+  page->bump = (unsigned char*)page + HEAP_FIRST_CELL;
+  page->limit = (unsigned char*)page + HEAP_PAGE_SIZE - page->cellSize;
+  page->epoch = heap_currentEpoch();
+  page->listed = false;
+  page->young = false;
+  return page;
+}
+
+/* the bit of the object whose first field is at value */
+#define heap_markIndex(value) (((size_t)(value) & (HEAP_PAGE_SIZE - 1)) / HEAP_GRANULE)
+
+void heap_setMark(heap_page* page, void* value)
+{
+  size_t bit = heap_markIndex(value);
+  page->marks[bit / HEAP_WORD_BITS] |= (size_t)1 << (bit % HEAP_WORD_BITS);
+}
+
+bool heap_clearMark(heap_page* page, void* value)
+{
+  size_t bit = heap_markIndex(value);
+  size_t mask = (size_t)1 << (bit % HEAP_WORD_BITS);
+  size_t* word = &page->marks[bit / HEAP_WORD_BITS];
+  if (!(*word & mask))
+    return false;
+  *word &= ~mask;
+  return true;
+}
+
+/*
+  old objects born on a page the running sweep has not reached yet are marked so they survive it, and so are
+  those born while the collector marks. between the end of a sweep and the next marking they are born unmarked,
+  the marking that follows reaches them from the roots like any other.
+*/
+void heap_allocateBlack(heap_page* page, unsigned char* cell)
+{
+  if (heapSweeping ? (page->epoch != heapEpoch) : heapMarking)
+    heap_setMark(page, &((size_t*)cell)[1]);
+}
+
+/* called by the collector as it starts and stops marking */
+void heap_setMarking(bool marking)
+{
+  heap_lock();
+  heapMarking = marking;
+  heap_unlock();
+}
+
+/* gives a range back to the large object space, a range reaching the top lowers the top instead */
+void heap_returnRange(unsigned char* start, size_t size)
+{
+  heap_range** link = &largeRanges;
+  heap_range** prevLink = 0;
+  while (*link && ((*link)->start < start))
+  {
+    prevLink = link;
+    link = &(*link)->next;
+  }
+  heap_range* next = *link;
+  heap_range* range;
+  if (prevLink && ((*prevLink)->start + (*prevLink)->size == start))
+  {
+    link = prevLink;
+    range = *link;
+    range->size += size;
+  }
+  else
+  {
+    range = malloc(sizeof(heap_range));
+    if (!range)
+      abort();
+    range->start = start;
+    range->size = size;
+    range->next = next;
+    *link = range;
+  }
+  if (next && (range->start + range->size == next->start))
+  {
+    range->size += next->size;
+    range->next = next->next;
+    free(next);
+  }
+  if (range->start + range->size == largeTop)
+  {
+    largeTop = range->start;
+    *link = 0;
+    free(range);
+  }
+}
+
+/* a range of pages from the large object space, zeroed */
+heap_page* heap_takeLarge(size_t pageCount)
+{
+  size_t size = pageCount << HEAP_PAGE_SHIFT;
+  heap_range** link = &largeRanges;
+  while (*link)
+  {
+    heap_range* range = *link;
+    if (range->size >= size)
+    {
+      unsigned char* start = range->start;
+      range->start += size;
+      range->size -= size;
+      if (range->size == 0)
+      {
+        *link = range->next;
+        free(range);
+      }
+#ifdef pwin32
+      // released ranges are decommitted
+      if (!VirtualAlloc(start, size, MEM_COMMIT, PAGE_READWRITE))
+      {
+        heap_returnRange(start, size);
+        return 0;
+      }
+#endif
+      return (heap_page*)start;
+    }
+    link = &range->next;
+  }
+  if (size > (size_t)(arenaEnd - largeTop))
+    return 0;
+  if (!heap_commit(&largeCommitted, largeTop + size, arenaEnd))
+    return 0;
+  heap_page* page = (heap_page*)largeTop;
+  largeTop += size;
+  return page;
+}
+
+/* the memory goes back to the system, the range stays reserved so no other mapping can move in */
+void heap_releaseLarge(heap_page* page)
+{
+  size_t size = page->pageCount << HEAP_PAGE_SHIFT;
+  heap_mapRun(page, page->pageCount, 0);
+  heapPageCount -= page->pageCount;
+#ifdef pwin32
+  VirtualFree(page, size, MEM_DECOMMIT);
+#else
+  madvise(page, size, MADV_DONTNEED);
+#endif
+  heap_returnRange((unsigned char*)page, size);
+}
+
+void* heap_allocateLarge(size_t size)
+{
+  size_t pageCount = (HEAP_FIRST_CELL + size + HEAP_PAGE_SIZE - 1) >> HEAP_PAGE_SHIFT;
+  heap_page* page = heap_takeLarge(pageCount);
+  if (!page)
+    return 0;
+  heapPageCount += pageCount;
+  heap_mapRun(page, pageCount, page);
+  page->next = 0;
+  page->prev = 0;
+  page->pageCount = pageCount;
+  page->sizeClass = HEAP_LARGE;
+  page->cellSize = size;
+  page->liveCount = 1;
+  page->freeList = 0;
+  page->bump = 0;
+  page->limit = 0;
+  page->epoch = heap_currentEpoch();
+  page->listed = false;
+  page->young = false;
+  unsigned char* cell = (unsigned char*)page + HEAP_FIRST_CELL;
+  heap_allocateBlack(page, cell);
+  return cell;
+}
+
+void* heap_allocateCell(size_t size)
+{
+  if (size > HEAP_MAX_SMALL)
+    return heap_allocateLarge(size);
+  size_t c = heapClassLookup[(size + 7) >> 3];
+  heap_class* cls = &heapClasses[c];
+  heap_page* page = cls->pages;
+  if (!page)
+  {
+    page = heap_newPage(c);
+    if (!page)
+      return 0;
+    heap_link(cls, page);
+  }
+  unsigned char* cell;
+  if (page->freeList)
+  {
+    cell = (unsigned char*)page->freeList;
+    page->freeList = (size_t*)page->freeList[1];
+  }
+  else
+  {
+    cell = page->bump;
+    page->bump += page->cellSize;
+  }
+  page->liveCount++;
+  if ((!page->freeList) && (page->bump > page->limit))
+    heap_unlink(cls, page);
+  memset(cell, 0, size);
+  heap_allocateBlack(page, cell);
+  return cell;
+}
+
+/* returns zeroed memory of atleast size bytes, or 0 if the arena is exhausted */
+void* heap_allocate(size_t size)
+{
+  if (!heapInitialized)
+    heap_init();
+  heap_lock();
+  void* cell = heap_allocateCell(size);
+  heap_unlock();
+  return cell;
+}
+
+void heap_freeCell(void* cell)
+{
+  heap_page* page = (heap_page*)((size_t)cell & ~(HEAP_PAGE_SIZE - 1));
+  if (page->sizeClass == HEAP_LARGE)
+  {
+    heap_releaseLarge(page);
+    return;
+  }
+  heap_class* cls = &heapClasses[page->sizeClass];
+  page->liveCount--;
+  if (page->liveCount == 0)
+  {
+    // keep the last page of a class around so a single object coming and going doesn't churn pages
+    if ((cls->pages == page) && (!page->next))
+    {
+      page->freeList = 0;
+      page->bump = (unsigned char*)page + HEAP_FIRST_CELL;
+      return;
+    }
+    if (page->listed)
+      heap_unlink(cls, page);
+    heap_releaseRun(page, 1);
+    return;
+  }
+  ((size_t*)cell)[0] = 0;
+  ((size_t*)cell)[1] = (size_t)page->freeList;
+  page->freeList = (size_t*)cell;
+  if (!page->listed)
+    heap_link(cls, page);
+}
+
+void heap_free(void* cell)
+{
+  heap_lock();
+  heap_freeCell(cell);
+  heap_unlock();
+}
+
+/* bump allocates zeroed memory in the nursery, requests too large for a size class end up as old objects */
+void* heap_allocateYoung(size_t size)
+{
+  if (!heapInitialized)
+    heap_init();
+  if (size > HEAP_MAX_SMALL)
+    return heap_allocate(size);
+  size_t c = heapClassLookup[(size + 7) >> 3];
+  heap_nursery* nursery = heapOwnNursery;
+  heap_page* page = nursery->pages[c];
+  if ((!page) || (page->bump > page->limit))
+  {
+    heap_lock();
+    if (page)
+    {
+      page->next = nurseryPages;
+      nurseryPages = page;
+    }
+    page = heap_newPage(c);
+    heap_unlock();
+    nursery->pages[c] = page;
+    if (!page)
+      return 0;
+    page->young = true;
+  }
+  unsigned char* cell = page->bump;
+  page->bump += page->cellSize;
+  nursery->bytes += page->cellSize;
+  memset(cell, 0, size);
+  return cell;
+}
+
+/* the reserved range of the arena, every collected object lives inside of it */
+void heap_arena(size_t* base, size_t* size)
+{
+  if (!heapInitialized)
+    heap_init();
+  *base = (size_t)arenaBase;
+  *size = (size_t)(arenaEnd - arenaBase);
+}
+
+/* the nursery of the calling thread */
+size_t heap_nurseryBytes()
+{
+  return heapOwnNursery->bytes;
+}
+
+/* gives the calling thread a nursery of its own, the collector must not run meanwhile */
+void heap_attachThread()
+{
+  heap_nursery* nursery = calloc(1, sizeof(heap_nursery));
+  if (!nursery)
+    abort();
+  heap_lock();
+  nursery->next = heapNurseries;
+  heapNurseries = nursery;
+  heap_unlock();
+  heapOwnNursery = nursery;
+}
+
+/* hands the nursery pages of the calling thread to the next minor collection */
+void heap_detachThread()
+{
+  heap_nursery* nursery = heapOwnNursery;
+  heap_nursery** link = &heapNurseries;
+  size_t c;
+  if (nursery == &heapMainNursery)
+    return;
+  heap_lock();
+  while (*link != nursery)
+    link = &(*link)->next;
+  *link = nursery->next;
+  for (c = 0; c < HEAP_CLASS_COUNT; ++c)
+    if (nursery->pages[c])
+    {
+      nursery->pages[c]->next = nurseryPages;
+      nurseryPages = nursery->pages[c];
+    }
+  heap_unlock();
+  heapOwnNursery = &heapMainNursery;
+  free(nursery);
+}
+
+/* bytes of all pages in use, old and young */
+size_t heap_bytes()
+{
+  return heapPageCount << HEAP_PAGE_SHIFT;
+}
+
+/* page indices run over the small pages and then over the large object space, the unused pages in between are skipped */
+size_t heap_skipGap(size_t index)
+{
+  size_t smallEnd = (size_t)(arenaTop - arenaBase) >> HEAP_PAGE_SHIFT;
+  size_t largeStart = (size_t)(largeBase - arenaBase) >> HEAP_PAGE_SHIFT;
+  if ((index >= smallEnd) && (index < largeStart))
+    return largeStart;
+  return index;
+}
+
+/* bytes of the cells in use, garbage not swept yet and the whole nursery included */
+size_t heap_liveBytes()
+{
+  size_t bytes = 0;
+  size_t i = 0;
+  if (!heapInitialized)
+    return 0;
+  heap_lock();
+  size_t end = (size_t)(largeTop - arenaBase) >> HEAP_PAGE_SHIFT;
+  while ((i = heap_skipGap(i)) < end)
+  {
+    heap_page* page = pageMap[i];
+    if (!page)
+    {
+      i++;
+      continue;
+    }
+    i += page->pageCount;
+    if (page->sizeClass == HEAP_LARGE)
+      bytes += page->cellSize;
+    else if (page->young)
+      bytes += (size_t)(page->bump - ((unsigned char*)page + HEAP_FIRST_CELL));
+    else
+      bytes += page->liveCount * page->cellSize;
+  }
+  heap_unlock();
+  return bytes;
+}
+
+/* p may be a slot anywhere inside an object, past the first page of a large one there is no header to read */
+bool heap_isYoung(void* p)
+{
+  if (((unsigned char*)p < arenaBase) || ((unsigned char*)p >= arenaTop))
+    return false;
+  heap_page* page = pageMap[((unsigned char*)p - arenaBase) >> HEAP_PAGE_SHIFT];
+  return page && page->young;
+}
+
+/* sets the mark bit of the object, returns false if it was already marked */
+bool heap_mark(size_t* value)
+{
+  heap_page* page = (heap_page*)((size_t)value & ~(HEAP_PAGE_SIZE - 1));
+  size_t bit = heap_markIndex(value);
+  size_t mask = (size_t)1 << (bit % HEAP_WORD_BITS);
+  size_t* word = &page->marks[bit / HEAP_WORD_BITS];
+  if (*word & mask)
+    return false;
+  *word |= mask;
+  return true;
+}
+
+/* for markers running side by side, neighbouring cells share the bitmap word */
+bool heap_markAtomic(size_t* value)
+{
+  heap_page* page = (heap_page*)((size_t)value & ~(HEAP_PAGE_SIZE - 1));
+  size_t bit = heap_markIndex(value);
+  size_t mask = (size_t)1 << (bit % HEAP_WORD_BITS);
+  size_t* word = &page->marks[bit / HEAP_WORD_BITS];
+  if (*word & mask)
+    return false;
+  return !(__sync_fetch_and_or(word, mask) & mask);
+}
+
+bool heap_isMarked(size_t* value)
+{
+  heap_page* page = (heap_page*)((size_t)value & ~(HEAP_PAGE_SIZE - 1));
+  size_t bit = heap_markIndex(value);
+  return (page->marks[bit / HEAP_WORD_BITS] >> (bit % HEAP_WORD_BITS)) & 1;
+}
+
+/* dirties the card holding the slot, slots outside of the arena live on stacks or in globals which are roots anyway */
+void heap_remember(void* slot)
+{
+  if (((unsigned char*)slot < arenaBase) || ((unsigned char*)slot >= largeTop))
+    return;
+  if (((unsigned char*)slot >= arenaTop) && ((unsigned char*)slot < largeBase))
+    return;
+  size_t card = ((unsigned char*)slot - arenaBase) >> HEAP_CARD_SHIFT;
+  if (heapCards[card])
+    return;
+  // the card might be dirtied from several threads at once
+  heap_lock();
+  if (!heapCards[card])
+  {
+    heapCards[card] = 1;
+    if (dirtyCount == dirtyCapacity)
+    {
+      dirtyCapacity *= 2;
+      dirtyCards = realloc(dirtyCards, dirtyCapacity * sizeof(size_t));
+      if (!dirtyCards)
+        abort();
+    }
+    dirtyCards[dirtyCount++] = card;
+  }
+  heap_unlock();
+}
+
+/* visits every old cell overlapping a dirty card with the card bounds, and cleans the cards */
+void heap_scanRemembered(void (*visit)(size_t* cell, size_t* from, size_t* to))
+{
+  heap_lock();
+  while (dirtyCount)
+  {
+    size_t card = dirtyCards[--dirtyCount];
+    heapCards[card] = 0;
+    unsigned char* from = arenaBase + (card << HEAP_CARD_SHIFT);
+    unsigned char* to = from + HEAP_CARD_SIZE;
+    heap_page* page = pageMap[card >> (HEAP_PAGE_SHIFT - HEAP_CARD_SHIFT)];
+    // released since the store, or swept by the minor collection itself
+    if ((!page) || page->young)
+      continue;
+    unsigned char* first = (unsigned char*)page + HEAP_FIRST_CELL;
+    if (page->sizeClass == HEAP_LARGE)
+    {
+      visit((size_t*)first, (size_t*)from, (size_t*)to);
+      continue;
+    }
+    unsigned char* cell = first;
+    if (from > first)
+      cell = first + ((size_t)(from - first) / page->cellSize) * page->cellSize;
+    if (to > page->bump)
+      to = page->bump;
+    while (cell < to)
+    {
+      if (((size_t*)cell)[0])
+        visit((size_t*)cell, (size_t*)from, (size_t*)to);
+      cell += page->cellSize;
+    }
+  }
+  heap_unlock();
+}
+
+/* returns the number of objects freed, current is the slot of a page some thread still bumps through */
+size_t heap_sweepNurseryPage(heap_page* page, heap_page** current, void (*promoted)(size_t* value))
+{
+  heap_class* cls = &heapClasses[page->sizeClass];
+  unsigned char* cell = (unsigned char*)page + HEAP_FIRST_CELL;
+  size_t* freeList = 0;
+  size_t survivors = 0;
+  size_t freed = 0;
+  while (cell < page->bump)
+  {
+    size_t* value = &((size_t*)cell)[1];
+    if (heap_clearMark(page, value))
+      survivors++;
+    else
+    {
+      ((size_t*)cell)[0] = 0;
+      ((size_t*)cell)[1] = (size_t)freeList;
+      freeList = (size_t*)cell;
+      freed++;
+    }
+    cell += page->cellSize;
+  }
+  if (survivors == 0)
+  {
+    if (current)
+      page->bump = (unsigned char*)page + HEAP_FIRST_CELL;
+    else
+      heap_releaseRun(page, 1);
+    return freed;
+  }
+  // promote the page in place, the minor marks are gone so the collector can mark the survivors again
+  if (current)
+    *current = 0;
+  page->young = false;
+  page->liveCount = survivors;
+  page->freeList = freeList;
+  page->epoch = heap_currentEpoch();
+  if (freeList || (page->bump <= page->limit))
+    heap_link(cls, page);
+  cell = (unsigned char*)page + HEAP_FIRST_CELL;
+  while (cell < page->bump)
+  {
+    if (((size_t*)cell)[0])
+      promoted(&((size_t*)cell)[1]);
+    cell += page->cellSize;
+  }
+  return freed;
+}
+
+/* sweeps all nursery pages, marked objects survive and are handed to promoted, returns the number of objects freed */
+size_t heap_sweepNursery(void (*promoted)(size_t* value))
+{
+  size_t c;
+  size_t freed = 0;
+  heap_nursery* nursery;
+  heap_lock();
+  while (nurseryPages)
+  {
+    heap_page* page = nurseryPages;
+    nurseryPages = page->next;
+    page->next = 0;
+    freed += heap_sweepNurseryPage(page, 0, promoted);
+  }
+  for (nursery = heapNurseries; nursery; nursery = nursery->next)
+  {
+    for (c = 0; c < HEAP_CLASS_COUNT; ++c)
+      if (nursery->pages[c])
+        freed += heap_sweepNurseryPage(nursery->pages[c], &nursery->pages[c], promoted);
+    nursery->bytes = 0;
+  }
+  heap_unlock();
+  return freed;
+}
+
+/* rebuilds the free list of an old page from its mark bits, returns the number of objects freed */
+size_t heap_sweepPage(heap_page* page, bool keepDead)
+{
+  heap_class* cls = &heapClasses[page->sizeClass];
+  unsigned char* cell = (unsigned char*)page + HEAP_FIRST_CELL;
+  size_t* freeList = 0;
+  size_t survivors = 0;
+  size_t freed = 0;
+  page->epoch = heapEpoch;
+  while (cell < page->bump)
+  {
+    size_t* value = &((size_t*)cell)[1];
+    if (heap_clearMark(page, value))
+      survivors++;
+    else if (((size_t*)cell)[0] && keepDead)
+      survivors++;
+    else
+    {
+      if (((size_t*)cell)[0])
+        freed++;
+      ((size_t*)cell)[0] = 0;
+      ((size_t*)cell)[1] = (size_t)freeList;
+      freeList = (size_t*)cell;
+    }
+    cell += page->cellSize;
+  }
+  page->liveCount = survivors;
+  page->freeList = freeList;
+  if (survivors == 0)
+  {
+    // keep the last page of a class around so a single object coming and going doesn't churn pages
+    if ((cls->pages == page) && (!page->next))
+    {
+      page->freeList = 0;
+      page->bump = (unsigned char*)page + HEAP_FIRST_CELL;
+      return freed;
+    }
+    if (page->listed)
+      heap_unlink(cls, page);
+    heap_releaseRun(page, 1);
+    return freed;
+  }
+  if ((!page->listed) && (freeList || (page->bump <= page->limit)))
+    heap_link(cls, page);
+  return freed;
+}
+
+void heap_beginSweep()
+{
+  heap_lock();
+  heapSweeping = true;
+  sweepCursor = 0;
+  heap_unlock();
+}
+
+/* whether the sweeper thread is at a sweep, which leaves nothing for the program to do */
+bool heap_sweeperBusy()
+{
+  return sweeperRunning && heapSweeping;
+}
+
+bool heap_sweepPages(size_t pageCount, bool keepDead, size_t* freed)
+{
+  size_t end = (size_t)(largeTop - arenaBase) >> HEAP_PAGE_SHIFT;
+  while ((sweepCursor = heap_skipGap(sweepCursor)) < end)
+  {
+    heap_page* page = pageMap[sweepCursor];
+    if (!page)
+    {
+      sweepCursor++;
+      continue;
+    }
+    sweepCursor += page->pageCount;
+    if (page->young || (page->epoch == heapEpoch))
+      continue;
+    if (page->sizeClass == HEAP_LARGE)
+    {
+      page->epoch = heapEpoch;
+      if (!heap_clearMark(page, &((size_t*)((unsigned char*)page + HEAP_FIRST_CELL))[1]) && !keepDead)
+      {
+        heap_releaseLarge(page);
+        (*freed)++;
+      }
+    }
+    else
+      *freed += heap_sweepPage(page, keepDead);
+    if (--pageCount == 0)
+      return false;
+  }
+  if (heapSweeping)
+  {
+    heapSweeping = false;
+    heapEpoch++;
+  }
+  return true;
+}
+
+/*
+  sweeps up to pageCount pages in address order, freed is increased by the number of objects freed.
+  returns true once every page is swept, the epoch moves on and the next marking can start.
+  while the sweeper thread has the sweep this only reports on it.
+*/
+bool heap_sweepStep(size_t pageCount, bool keepDead, size_t* freed)
+{
+  bool done;
+  if (heap_sweeperBusy())
+    return false;
+  heap_lock();
+  done = heap_sweepPages(pageCount, keepDead, freed);
+  *freed += sweeperFreed;
+  sweeperFreed = 0;
+  heap_unlock();
+  return done;
+}
+
+/* finishes the sweep on the calling thread, together with the sweeper if it is at it */
+size_t heap_sweepAll(bool keepDead)
+{
+  size_t freed = 0;
+  heap_lock();
+  while (!heap_sweepPages((size_t)-1, keepDead, &freed))
+    ;
+  freed += sweeperFreed;
+  sweeperFreed = 0;
+  heap_unlock();
+  return freed;
+}
+
+#ifndef pwin32
+void* heap_sweeper(void* argument)
+{
+  heap_lock();
+  while (true)
+  {
+    while (!heapSweeping)
+      pthread_cond_wait(&sweeperWake, &heapLock);
+    if (!heap_sweepPages(HEAP_SWEEP_BATCH, sweeperKeepDead, &sweeperFreed))
+    {
+      heap_unlock();
+      sched_yield();
+      heap_lock();
+    }
+  }
+  return 0;
+}
+#endif
+
+/* hands the sweep that was just begun to the sweeper thread, returns false if there is none */
+realignedStack bool heap_sweepInBackground(bool keepDead)
+{
+#ifdef pwin32
+  return false;
+#else
+  if (!sweeperConfigured)
+  {
+    sweeperConfigured = true;
+    char* setting = getenv("PLUK_GC_BACKGROUND_SWEEP");
+    if ((!setting) || (strtol(setting, 0, 10) != 0))
+    {
+      pthread_t thread;
+      sigset_t all, previous;
+      sigfillset(&all);
+      pthread_sigmask(SIG_SETMASK, &all, &previous);
+      if (!pthread_create(&thread, 0, heap_sweeper, 0))
+      {
+        pthread_detach(thread);
+        sweeperRunning = true;
+      }
+      pthread_sigmask(SIG_SETMASK, &previous, 0);
+    }
+  }
+  if (!sweeperRunning)
+    return false;
+  heap_lock();
+  sweeperKeepDead = keepDead;
+  pthread_cond_signal(&sweeperWake);
+  heap_unlock();
+  return true;
+#endif
+}
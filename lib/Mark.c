@@ -0,0 +1,260 @@
+#include <pluk.h>
+
+#ifndef pwin32
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#endif
+
+/*
+  Parallel marking for full collections.
+
+  Every marker owns a private grey stack it works from without locking and a
+  shared stack the other markers steal from. When its shared stack has run
+  dry and the private one is deep enough the owner moves half of the private
+  stack over. A marker that runs out of work first takes back its own shared
+  stack and then steals half of the shared stack of another marker.
+  Mark bits are set with an atomic or since neighbouring cells share a bitmap
+  word. Marking is finished once every marker is idle, an idle marker holds no
+  work and only leaves the idle state to steal, so none can be left behind.
+
+  The thread calling mark_parallel is marker 0, the others are threads of a
+  pool that is started on the first full collection and waits in between.
+  PLUK_GC_MARK_THREADS sets the number of markers, unset or 1 keeps marking
+  serial, as does a platform without pthreads.
+*/
+
+// from Heap.c
+bool heap_isYoung(void* p);
+bool heap_markAtomic(size_t* value);
+
+#ifndef pwin32
+
+#define MARK_MAX_THREADS 64
+#define MARK_PUBLISH 64
+
+typedef struct
+{
+  size_t** items;
+  size_t count;
+  size_t capacity;
+} mark_stack;
+
+typedef struct
+{
+  mark_stack local;
+  mark_stack shared;
+  volatile size_t available;
+  pthread_mutex_t lock;
+} marker;
+
+marker markers[MARK_MAX_THREADS];
+size_t markerCount = 1;
+bool markConfigured = false;
+volatile size_t markIdle;
+size_t markGeneration;
+size_t markFinished;
+pthread_mutex_t markPoolLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t markPoolStart = PTHREAD_COND_INITIALIZER;
+pthread_cond_t markPoolDone = PTHREAD_COND_INITIALIZER;
+
+void markPush(mark_stack* stack, size_t* data)
+{
+  if (stack->count == stack->capacity)
+  {
+    stack->capacity = stack->capacity ? stack->capacity * 2 : 1024;
+    stack->items = realloc(stack->items, stack->capacity * sizeof(size_t*));
+    if (!stack->items)
+      abort();
+  }
+  stack->items[stack->count++] = data;
+}
+
+/* moves the top count items of from onto to */
+void markMove(mark_stack* from, mark_stack* to, size_t count)
+{
+  while (count--)
+    markPush(to, from->items[--from->count]);
+}
+
+void markScan(marker* m, size_t* data)
+{
+  size_t fieldCount = data[-1] >> 1;
+  while (fieldCount--)
+  {
+    pref* reference = (pref*)&data[fieldCount << 1];
+    size_t* t = reference->type;
+    if ((t == 0) || (t[0] == 0))
+      continue;
+    size_t* value = reference->value;
+    if (value == 0)
+      continue;
+    if (heap_isYoung(value))
+      continue;
+    if (heap_markAtomic(value))
+      markPush(&m->local, value);
+  }
+}
+
+void markPublish(marker* m)
+{
+  if (m->available || (m->local.count < 2 * MARK_PUBLISH))
+    return;
+  pthread_mutex_lock(&m->lock);
+  markMove(&m->local, &m->shared, m->local.count / 2);
+  m->available = m->shared.count;
+  pthread_mutex_unlock(&m->lock);
+}
+
+bool markTake(marker* m, marker* victim, bool all)
+{
+  if (!victim->available)
+    return false;
+  pthread_mutex_lock(&victim->lock);
+  size_t count = all ? victim->shared.count : (victim->shared.count + 1) / 2;
+  markMove(&victim->shared, &m->local, count);
+  victim->available = victim->shared.count;
+  pthread_mutex_unlock(&victim->lock);
+  return count != 0;
+}
+
+bool markSteal(size_t index)
+{
+  marker* m = &markers[index];
+  size_t i;
+  if (markTake(m, m, true))
+    return true;
+  for (i = 1; i < markerCount; i++)
+    if (markTake(m, &markers[(index + i) % markerCount], false))
+      return true;
+  return false;
+}
+
+bool markAnyAvailable()
+{
+  size_t i;
+  for (i = 0; i < markerCount; i++)
+    if (markers[i].available)
+      return true;
+  return false;
+}
+
+void markRun(size_t index)
+{
+  marker* m = &markers[index];
+  while (true)
+  {
+    while (m->local.count)
+    {
+      markScan(m, m->local.items[--m->local.count]);
+      markPublish(m);
+    }
+    if (markSteal(index))
+      continue;
+    __sync_fetch_and_add(&markIdle, 1);
+    while (true)
+    {
+      if (markIdle == markerCount)
+        return;
+      if (markAnyAvailable())
+      {
+        __sync_fetch_and_sub(&markIdle, 1);
+        break;
+      }
+      sched_yield();
+    }
+  }
+}
+
+void* markThread(void* argument)
+{
+  size_t index = (size_t)argument;
+  size_t seen = 0;
+  while (true)
+  {
+    pthread_mutex_lock(&markPoolLock);
+    while (markGeneration == seen)
+      pthread_cond_wait(&markPoolStart, &markPoolLock);
+    seen = markGeneration;
+    pthread_mutex_unlock(&markPoolLock);
+
+    markRun(index);
+
+    pthread_mutex_lock(&markPoolLock);
+    markFinished++;
+    if (markFinished == markerCount - 1)
+      pthread_cond_signal(&markPoolDone);
+    pthread_mutex_unlock(&markPoolLock);
+  }
+  return 0;
+}
+
+/* starts the pool, markers that fail to start are left out. signals stay with the mutator threads */
+void markConfigure()
+{
+  markConfigured = true;
+  char* setting = getenv("PLUK_GC_MARK_THREADS");
+  if (!setting)
+    return;
+  long wanted = strtol(setting, 0, 10);
+  if (wanted <= 1)
+    return;
+  if (wanted > MARK_MAX_THREADS)
+    wanted = MARK_MAX_THREADS;
+
+  sigset_t all, previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  size_t i;
+  pthread_mutex_init(&markers[0].lock, 0);
+  for (i = 1; i < (size_t)wanted; i++)
+  {
+    pthread_t thread;
+    pthread_mutex_init(&markers[i].lock, 0);
+    if (pthread_create(&thread, 0, markThread, (void*)i))
+      break;
+    pthread_detach(thread);
+    markerCount = i + 1;
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, 0);
+}
+
+/*
+  marks everything reachable from the grey objects given, which have their mark bits set already.
+  returns false without doing anything when marking is serial.
+*/
+realignedStack bool mark_parallel(size_t** items, size_t count)
+{
+  if (!markConfigured)
+    markConfigure();
+  if (markerCount < 2)
+    return false;
+
+  size_t i;
+  for (i = 0; i < count; i++)
+    markPush(&markers[i % markerCount].local, items[i]);
+
+  pthread_mutex_lock(&markPoolLock);
+  markIdle = 0;
+  markFinished = 0;
+  markGeneration++;
+  pthread_cond_broadcast(&markPoolStart);
+  pthread_mutex_unlock(&markPoolLock);
+
+  markRun(0);
+
+  pthread_mutex_lock(&markPoolLock);
+  while (markFinished != markerCount - 1)
+    pthread_cond_wait(&markPoolDone, &markPoolLock);
+  pthread_mutex_unlock(&markPoolLock);
+  return true;
+}
+
+#else
+
+bool mark_parallel(size_t** items, size_t count)
+{
+  return false;
+}
+
+#endif
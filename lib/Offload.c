@@ -0,0 +1,140 @@
+#include <pluk.h>
+
+#ifndef pwin32
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#endif
+
+/*
+  A pool of native threads for the calls that block, file opens and transfers and name lookups, so the
+  fiber making one yields instead of stalling every other fiber of its scheduler thread.
+
+  A job embeds an offload_job first. The workers only ever run its run function, which must not touch
+  collected memory other than buffers kept alive by the yielding fiber, collected memory does not move.
+  Every job gets an eventfd the worker writes once it is done, the fiber watches it through the Poller
+  as OffloadWaitable. offload_finish closes it again, the job itself belongs to the caller. Setting done
+  is the last thing the worker does with a job.
+
+  The pool starts on the first job. PLUK_OFFLOAD_THREADS sets its size, 0 turns offloading off and the
+  calls block the thread that makes them as before, as they do on a platform without pthreads.
+*/
+
+#define OFFLOAD_DEFAULT_THREADS 4
+#define OFFLOAD_MAX_THREADS 64
+
+#ifndef pwin32
+
+offload_job* offloadFirst;
+offload_job* offloadLast;
+size_t offloadThreads;
+bool offloadConfigured = false;
+pthread_mutex_t offloadLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t offloadQueued = PTHREAD_COND_INITIALIZER;
+
+void* offloadThread(void* argument)
+{
+  while (true)
+  {
+    pthread_mutex_lock(&offloadLock);
+    while (!offloadFirst)
+      pthread_cond_wait(&offloadQueued, &offloadLock);
+    offload_job* job = offloadFirst;
+    offloadFirst = job->next;
+    if (!offloadFirst)
+      offloadLast = 0;
+    pthread_mutex_unlock(&offloadLock);
+
+    job->run(job);
+    // done goes last, the fiber can take it from Test right away and finish and free the job
+    int event = job->event;
+    eventfd_write(event, 1);
+    __atomic_store_n(&job->done, true, __ATOMIC_RELEASE);
+  }
+  return 0;
+}
+
+/* starts the pool under offloadLock, workers that fail to start are left out. signals stay with the mutators */
+void offloadConfigure()
+{
+  offloadConfigured = true;
+  long wanted = OFFLOAD_DEFAULT_THREADS;
+  char* setting = getenv("PLUK_OFFLOAD_THREADS");
+  if (setting)
+    wanted = strtol(setting, 0, 10);
+  if (wanted > OFFLOAD_MAX_THREADS)
+    wanted = OFFLOAD_MAX_THREADS;
+
+  sigset_t all, previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  long i;
+  for (i = 0; i < wanted; i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, 0, offloadThread, 0))
+      break;
+    pthread_detach(thread);
+    offloadThreads++;
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, 0);
+}
+
+/* queues the job, false if there is no pool or no eventfd for it and the caller has to run it itself */
+realignedStack bool offload_submit(offload_job* job)
+{
+  pthread_mutex_lock(&offloadLock);
+  if (!offloadConfigured)
+    offloadConfigure();
+  if (!offloadThreads)
+  {
+    pthread_mutex_unlock(&offloadLock);
+    return false;
+  }
+  job->event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (job->event == -1)
+  {
+    pthread_mutex_unlock(&offloadLock);
+    return false;
+  }
+  job->done = false;
+  job->next = 0;
+  if (offloadLast)
+    offloadLast->next = job;
+  else
+    offloadFirst = job;
+  offloadLast = job;
+  pthread_cond_signal(&offloadQueued);
+  pthread_mutex_unlock(&offloadLock);
+  return true;
+}
+
+bool offload_done(offload_job* job)
+{
+  return __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+}
+
+void offload_finish(offload_job* job)
+{
+  close(job->event);
+}
+
+#else
+
+bool offload_submit(offload_job* job)
+{
+  return false;
+}
+
+bool offload_done(offload_job* job)
+{
+  return true;
+}
+
+void offload_finish(offload_job* job)
+{
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include <pluk.h>
+#include <time.h>
+
+/* microseconds of a monotonic clock */
+long clockMicroseconds()
+{
+#ifdef pwin32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (long)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+/* static extern int Milliseconds() */
+pref pluk_base_Clock__Milliseconds(pref this)
+{
+  return longToPref(clockMicroseconds() / 1000);
+}
+
+/* static extern int Microseconds() */
+pref pluk_base_Clock__Microseconds(pref this)
+{
+  return longToPref(clockMicroseconds());
+}
@@ -17,6 +17,10 @@ size_t* gc_globalsEnd;
 size_t* pluk_base_OverflowException;
 size_t* pluk_base_BoundsException;
 
+// from GC.c
+void gc_registerBarrier(size_t* barrier);
+void gc_configure();
+
 typedef struct
 {
   size_t length;
@@ -32,7 +36,7 @@ void pluk_base_exit(int status)
   exit(status);
 }
 
-void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfloat, size_t* pbstring, size_t* pbstaticstring, size_t* pbtype, size_t* stackTraceData, size_t* staticDataSlotsBegin, size_t* staticDataSlotsEnd, size_t* overflowType, size_t* boundsType)
+void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfloat, size_t* pbstring, size_t* pbstaticstring, size_t* pbtype, size_t* stackTraceData, size_t* staticDataSlotsBegin, size_t* staticDataSlotsEnd, size_t* overflowType, size_t* boundsType, size_t* barrier)
 {
   pluk_base_Bool = pbbool;
   pluk_base_Byte = pbbyte;
@@ -53,6 +57,8 @@ void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfl
   
   gc_globalsBegin = staticDataSlotsBegin;
   gc_globalsEnd = staticDataSlotsEnd;
+  gc_registerBarrier(barrier);
+  gc_configure();
 }
 
 void pluk_base_saveStackRoot(size_t* stackRoot)
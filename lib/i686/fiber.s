@@ -74,3 +74,30 @@ fiber_switch_inner:
 	movl	%edx, %esp
 	ret
 
+
+# switches from the running fiber in from straight to the suspended one in to,
+# to takes over the side from was switched to by so its next fiber_switch
+# returns there, from is left like after a fiber_switch of its own
+.globl _fiber_transfer
+_fiber_transfer:
+.globl fiber_transfer
+fiber_transfer:
+	pushl	%ebp
+	movl	%esp, %ebp
+	call	fiber_transfer_inner
+	popl	%ebp
+	ret
+
+fiber_transfer_inner:
+	movl	8(%ebp), %eax
+	movl	12(%ebp), %edx
+	movl	4(%eax), %ecx
+	movl	%ecx, 4(%edx)
+	movl	16(%ebp), %ecx
+	movl	%ecx, 4(%eax)
+	movl	(%eax), %ecx
+	movl	%esp, (%eax)
+	movl	(%edx), %eax
+	movl	%ecx, (%edx)
+	movl	%eax, %esp
+	ret
@@ -0,0 +1,26 @@
+#include <pluk.h>
+
+/* every scheduler thread has a processor of its own */
+
+//private static extern FiberProcessor? GetInstance();
+pref pluk_io_FiberProcessor__GetInstance(pref this)
+{
+  return *pluk_threadLocal(PLUK_LOCAL_PROCESSOR);
+}
+
+//private static extern void SetInstance(FiberProcessor instance);
+pref pluk_io_FiberProcessor__SetInstance(pref this, pref instance)
+{
+  pref* slot = pluk_threadLocal(PLUK_LOCAL_PROCESSOR);
+  *slot = instance;
+  pluk_touchGC(slot);
+  return nullToPref();
+}
+
+//private static extern int ConfiguredThreads();
+pref pluk_io_FiberProcessor__ConfiguredThreads(pref this)
+{
+  char* setting = getenv("PLUK_SCHEDULER_THREADS");
+  long threads = setting ? strtol(setting, 0, 10) : 1;
+  return longToPref((threads > 1) ? threads : 1);
+}
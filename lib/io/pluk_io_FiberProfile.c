@@ -0,0 +1,43 @@
+#define _DEFAULT_SOURCE
+#include <pluk.h>
+
+#include <string.h>
+#ifndef pwin32
+#include <signal.h>
+#endif
+
+/* SIGUSR1 asks for a dump of the fiber counters, the handler only notes it for the processors to see */
+
+int fiberProfileRequested;
+bool fiberProfileInstalled;
+
+#ifndef pwin32
+void fiberProfileSignal(int signal)
+{
+  __atomic_store_n(&fiberProfileRequested, 1, __ATOMIC_RELAXED);
+}
+#endif
+
+/* static extern void Install() */
+pref pluk_io_FiberProfile__Install(pref this)
+{
+#ifndef pwin32
+  if (__atomic_exchange_n(&fiberProfileInstalled, true, __ATOMIC_ACQ_REL))
+    return nullToPref();
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = fiberProfileSignal;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, 0);
+#endif
+  return nullToPref();
+}
+
+/* private static extern bool Requested() */
+pref pluk_io_FiberProfile__Requested(pref this)
+{
+  if (!__atomic_load_n(&fiberProfileRequested, __ATOMIC_RELAXED))
+    return boolToPref(false);
+  return boolToPref(__atomic_exchange_n(&fiberProfileRequested, 0, __ATOMIC_RELAXED) != 0);
+}
@@ -68,6 +68,7 @@ pref pluk_io_FileMetadataImpl__Retrieve(pref this)
     ts = localtime(&stbuf.st_mtime);
     strftime(&buf[0], 255, "%a, %d %b %Y %H:%M:%S %z", ts);
     fieldFromPref(this, 4) = cstrToPref(buf);
+    pluk_touchGC(&fieldFromPref(this, 4));
     
     return result;
   }
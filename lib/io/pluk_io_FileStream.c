@@ -10,13 +10,37 @@
 
 // [0] int filehandle
 // [1] int errorno
+// [2] bool regular
 
-/* extern void Open(string name, bool read, bool write, bool append, bool create, bool createOnly, bool truncate) */
-pref pluk_io_InnerFileStream__Open(pref this, pref filename, 
-  pref read, pref write, pref append, pref create, pref createOnly, pref truncate)
+/*
+  from a fiber opens and transfers on regular files go to the offload pool, the Start externs return the job
+  as ticket or 0 when the pool did not take it, the fiber then calls the blocking extern itself.
+*/
+
+typedef struct
+{
+  offload_job job;
+  char* name;
+  int flags;
+  int handle;
+  int error;
+  bool regular;
+} file_open;
+
+typedef struct
+{
+  offload_job job;
+  int handle;
+  unsigned char* data;
+  size_t length;
+  bool write;
+  ssize_t result;
+  int error;
+} file_transfer;
+
+int fileFlags(pref read, pref write, pref append, pref create, pref createOnly, pref truncate)
 {
   int flags = 0;
-  char* file;
   if (boolFromPref(read) && boolFromPref(read))
     flags |= O_RDWR;
   else
@@ -39,24 +63,77 @@ pref pluk_io_InnerFileStream__Open(pref this, pref filename,
   flags |= O_NOCTTY;
   flags |= O_NONBLOCK;
 #endif
-  
-  file = cstrFromPref(filename);
-  
-  int handle = open(file, flags, S_IRUSR | S_IWUSR
+  return flags;
+}
+
+void fileOpen(offload_job* job)
+{
+  file_open* request = (file_open*)job;
+  request->handle = open(request->name, request->flags, S_IRUSR | S_IWUSR
 #ifndef pwin32
  | S_IRGRP | S_IROTH
 #endif
 );
-  int error = 0;
-  if (handle == -1)
+  request->error = 0;
+  request->regular = false;
+  if (request->handle == -1)
   {
-    handle = 0;
-    error = errno;
+    request->handle = 0;
+    request->error = errno;
+    return;
   }
-  
-  fieldFromPref(this, 0) = longToPref(handle);
-  fieldFromPref(this, 1) = longToPref(error);
-  
+  struct stat stbuf;
+  if (fstat(request->handle, &stbuf) == 0)
+    request->regular = S_ISREG(stbuf.st_mode);
+}
+
+void fileOpened(pref this, file_open* request)
+{
+  fieldFromPref(this, 0) = longToPref(request->handle);
+  fieldFromPref(this, 1) = longToPref(request->error);
+  fieldFromPref(this, 2) = boolToPref(request->regular);
+}
+
+/* extern void InnerOpen(string name, bool read, bool write, bool append, bool create, bool createOnly, bool truncate) */
+pref pluk_io_InnerFileStream__InnerOpen(pref this, pref filename, 
+  pref read, pref write, pref append, pref create, pref createOnly, pref truncate)
+{
+  file_open request;
+  request.name = cstrFromPref(filename);
+  request.flags = fileFlags(read, write, append, create, createOnly, truncate);
+  fileOpen(&request.job);
+  fileOpened(this, &request);
+  return nullToPref();
+}
+
+/* extern int StartOpen(string name, bool read, bool write, bool append, bool create, bool createOnly, bool truncate) */
+pref pluk_io_InnerFileStream__StartOpen(pref this, pref filename,
+  pref read, pref write, pref append, pref create, pref createOnly, pref truncate)
+{
+  file_open* request = malloc(sizeof(file_open));
+  if (!request)
+    return longToPref(0);
+  // the worker can not read collected memory
+  request->name = strdup(cstrFromPref(filename));
+  request->flags = fileFlags(read, write, append, create, createOnly, truncate);
+  request->job.run = fileOpen;
+  if (!request->name || !offload_submit(&request->job))
+  {
+    free(request->name);
+    free(request);
+    return longToPref(0);
+  }
+  return longToPref((long)request);
+}
+
+/* extern void FinishOpen(int ticket) */
+pref pluk_io_InnerFileStream__FinishOpen(pref this, pref ticket)
+{
+  file_open* request = (file_open*)longFromPref(ticket);
+  offload_finish(&request->job);
+  fileOpened(this, request);
+  free(request->name);
+  free(request);
   return nullToPref();
 }
 
@@ -147,6 +224,58 @@ pref pluk_io_InnerFileStream__Write(pref this, pref buffer, pref offset, pref li
 #endif
 }
 
+void fileTransfer(offload_job* job)
+{
+  file_transfer* request = (file_transfer*)job;
+  if (request->write)
+    request->result = write(request->handle, request->data, request->length);
+  else
+    request->result = read(request->handle, request->data, request->length);
+  request->error = (request->result < 0) ? errno : 0;
+}
+
+/* extern int StartTransfer(Array<Byte> buffer, int offset, int limit, bool write) */
+pref pluk_io_InnerFileStream__StartTransfer(pref this, pref buffer, pref offset, pref limit, pref write)
+{
+  file_transfer* request = malloc(sizeof(file_transfer));
+  if (!request)
+    return longToPref(0);
+  request->handle = longFromPref(fieldFromPref(this, 0));
+  // the yielding fiber keeps the buffer alive
+  request->data = &(bptrFromPref(buffer)[longFromPref(offset)]);
+  request->length = sizetFromPref(limit);
+  request->write = boolFromPref(write);
+  request->job.run = fileTransfer;
+  if (!offload_submit(&request->job))
+  {
+    free(request);
+    return longToPref(0);
+  }
+  return longToPref((long)request);
+}
+
+/* extern int FinishTransfer(int ticket), the result is that of Read or Write */
+pref pluk_io_InnerFileStream__FinishTransfer(pref this, pref ticket)
+{
+  file_transfer* request = (file_transfer*)longFromPref(ticket);
+  offload_finish(&request->job);
+  ssize_t res = request->result;
+  if (res < 0)
+  {
+    if (request->error == EAGAIN)
+      res = 0;
+    else
+    {
+      res = -2;
+      fieldFromPref(this, 1) = longToPref(request->error);
+    }
+  }
+  else if (res == 0)
+    res = -1;
+  free(request);
+  return longToPref(res);
+}
+
 /* extern bool Close() */
 pref pluk_io_InnerFileStream__Close(pref this)
 {
@@ -0,0 +1,51 @@
+#include <pluk.h>
+
+#ifndef pwin32
+#include <pthread.h>
+#endif
+
+/*
+  the mutex lives in a collected blob, the first field of the lock. a thread blocked in Acquire is parked so the
+  others can collect meanwhile. there are no threads on windows, a lock is never contended.
+*/
+
+// from GC.c
+void gc_park(size_t* stackTrace);
+void gc_unpark();
+
+//private extern void Init();
+pref pluk_io_Lock__Init(pref this)
+{
+#ifndef pwin32
+  pref* holder = &fieldFromPref(this, 0);
+  holder->type = pluk_base_String; //lying
+  holder->value = pluk_allocateGC(0, sizeof(pthread_mutex_t), 0);
+  pluk_touchGC(holder);
+  pthread_mutex_init((pthread_mutex_t*)holder->value, 0);
+#endif
+  return nullToPref();
+}
+
+//extern void Acquire();
+pref pluk_io_Lock__Acquire(pref this, size_t* stackTrace)
+{
+#ifndef pwin32
+  pthread_mutex_t* mutex = (pthread_mutex_t*)fieldFromPref(this, 0).value;
+  if (pthread_mutex_trylock(mutex))
+  {
+    gc_park(stackTrace);
+    pthread_mutex_lock(mutex);
+    gc_unpark();
+  }
+#endif
+  return nullToPref();
+}
+
+//extern void Release();
+pref pluk_io_Lock__Release(pref this)
+{
+#ifndef pwin32
+  pthread_mutex_unlock((pthread_mutex_t*)fieldFromPref(this, 0).value);
+#endif
+  return nullToPref();
+}
@@ -0,0 +1,17 @@
+#include <pluk.h>
+
+// [0] int ticket
+
+//private extern int InnerHandle();
+pref pluk_io_OffloadWaitable__InnerHandle(pref this)
+{
+  offload_job* job = (offload_job*)longFromPref(fieldFromPref(this, 0));
+  return longToPref(job->event);
+}
+
+//private extern bool InnerTest();
+pref pluk_io_OffloadWaitable__InnerTest(pref this)
+{
+  offload_job* job = (offload_job*)longFromPref(fieldFromPref(this, 0));
+  return boolToPref(offload_done(job));
+}
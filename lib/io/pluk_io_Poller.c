@@ -0,0 +1,198 @@
+#include <pluk.h>
+
+#include <errno.h>
+#include <unistd.h>
+#ifdef pwin32
+#include <windows.h>
+#else
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+/*
+  one epoll instance for every thread, its processor blocks in it while every fiber waits.
+  watches are one shot, a handle reported ready is dropped until it is watched again. read and write
+  waiters of a handle share its registration, pollInterest keeps what they wait for.
+  an eventfd lets other threads end a Wait early, it is never reported as a ready handle.
+  without epoll nothing can be watched and Wait only sleeps, the waiters are tested instead.
+  Wait submits the transfers queued on the io_uring of the thread first, see pluk_io_Ring.c.
+*/
+
+#define POLL_READ 1
+#define POLL_WRITE 2
+#define POLL_EVENTS 256
+
+// from GC.c
+void gc_park(size_t* stackTrace);
+void gc_unpark();
+
+// from pluk_io_Ring.c
+void ring_flush();
+int ring_ready();
+
+#ifndef pwin32
+pluk_thread_local int pollHandle = -1;
+pluk_thread_local int pollWake = -1;
+pluk_thread_local unsigned char* pollInterest;
+pluk_thread_local size_t pollInterestCount;
+pluk_thread_local struct epoll_event pollEvents[POLL_EVENTS];
+
+bool pollOpen()
+{
+  if (pollHandle != -1)
+    return true;
+  pollHandle = epoll_create1(EPOLL_CLOEXEC);
+  if (pollHandle == -1)
+    return false;
+  pollWake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (pollWake != -1)
+  {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = 0;
+    event.data.fd = pollWake;
+    if (epoll_ctl(pollHandle, EPOLL_CTL_ADD, pollWake, &event))
+    {
+      close(pollWake);
+      pollWake = -1;
+    }
+  }
+  return true;
+}
+#endif
+
+/* static extern bool Watch(int handle, bool write) */
+pref pluk_io_Poller__Watch(pref this, pref handle, pref write)
+{
+#ifdef pwin32
+  return boolToPref(false);
+#else
+  int fd = longFromPref(handle);
+  if (fd < 0)
+    return boolToPref(false);
+  if (!pollOpen())
+    return boolToPref(false);
+  if ((size_t)fd >= pollInterestCount)
+  {
+    size_t count = pollInterestCount ? pollInterestCount : 64;
+    while (count <= (size_t)fd)
+      count *= 2;
+    unsigned char* interest = realloc(pollInterest, count);
+    if (!interest)
+      return boolToPref(false);
+    memset(&interest[pollInterestCount], 0, count - pollInterestCount);
+    pollInterest = interest;
+    pollInterestCount = count;
+  }
+  pollInterest[fd] |= boolFromPref(write) ? POLL_WRITE : POLL_READ;
+  struct epoll_event event;
+  event.events = EPOLLONESHOT;
+  if (pollInterest[fd] & POLL_READ)
+    event.events |= EPOLLIN;
+  if (pollInterest[fd] & POLL_WRITE)
+    event.events |= EPOLLOUT;
+  event.data.u64 = 0;
+  event.data.fd = fd;
+  // a closed handle drops out of the instance, its number can come back as a new handle
+  if (epoll_ctl(pollHandle, EPOLL_CTL_MOD, fd, &event) == 0)
+    return boolToPref(true);
+  if ((errno == ENOENT) && (epoll_ctl(pollHandle, EPOLL_CTL_ADD, fd, &event) == 0))
+    return boolToPref(true);
+  // regular files can not be watched, they are always ready anyway
+  pollInterest[fd] = 0;
+  return boolToPref(false);
+#endif
+}
+
+/* static extern int Wait(int timeout) */
+pref pluk_io_Poller__Wait(pref this, pref timeout, size_t* stackTrace)
+{
+  long milliseconds = longFromPref(timeout);
+#ifdef pwin32
+  if (milliseconds > 0)
+    SleepEx(milliseconds, FALSE);
+  return longToPref(0);
+#else
+  if (pollHandle == -1)
+  {
+    if (milliseconds > 0)
+    {
+      gc_park(stackTrace);
+      usleep(milliseconds * 1000);
+      gc_unpark();
+    }
+    return longToPref(0);
+  }
+  // the transfers queued meanwhile go in one submission
+  ring_flush();
+  int ring = ring_ready();
+  if (ring != -1)
+    milliseconds = 0;
+  // other threads collect meanwhile
+  gc_park(stackTrace);
+  int count = epoll_wait(pollHandle, pollEvents, POLL_EVENTS - 1, milliseconds);
+  gc_unpark();
+  // interrupted by a signal
+  if (count < 0)
+    count = 0;
+  int i;
+  if (ring != -1)
+  {
+    for (i = 0; i < count; ++i)
+      if (pollEvents[i].data.fd == ring)
+        break;
+    if (i == count)
+    {
+      pollEvents[count].events = EPOLLIN;
+      pollEvents[count].data.fd = ring;
+      count++;
+    }
+  }
+  int ready = 0;
+  for (i = 0; i < count; ++i)
+  {
+    int fd = pollEvents[i].data.fd;
+    if (fd == pollWake)
+    {
+      eventfd_t value;
+      eventfd_read(pollWake, &value);
+      continue;
+    }
+    pollInterest[fd] = 0;
+    pollEvents[ready++] = pollEvents[i];
+  }
+  return longToPref(ready);
+#endif
+}
+
+/* static extern int WakeHandle() */
+pref pluk_io_Poller__WakeHandle(pref this)
+{
+#ifdef pwin32
+  return longToPref(-1);
+#else
+  if (!pollOpen())
+    return longToPref(-1);
+  return longToPref(pollWake);
+#endif
+}
+
+/* static extern void Wake(int handle) */
+pref pluk_io_Poller__Wake(pref this, pref handle)
+{
+#ifndef pwin32
+  if (longFromPref(handle) >= 0)
+    eventfd_write(longFromPref(handle), 1);
+#endif
+  return nullToPref();
+}
+
+/* static extern int ReadyHandle(int index) */
+pref pluk_io_Poller__ReadyHandle(pref this, pref index)
+{
+#ifdef pwin32
+  return longToPref(-1);
+#else
+  return longToPref(pollEvents[longFromPref(index)].data.fd);
+#endif
+}
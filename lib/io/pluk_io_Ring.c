@@ -0,0 +1,287 @@
+#define _DEFAULT_SOURCE
+#include <pluk.h>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#ifndef pwin32
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#endif
+#if !defined(pwin32) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define RING_SUPPORTED
+#endif
+
+/*
+  completion based reads and writes, one io_uring for every scheduler thread. PLUK_IO_URING=1 turns it on.
+  a fiber queues its transfer and yields until the completion is in. the queued ones are submitted together
+  with a single io_uring_enter when the processor polls, ring_flush is called by Poller.Wait. the ring handle
+  is watched like any other and the completions are reaped by whichever waiter tests first. reaping can take
+  in the completion of a waiter that is watching again already, the handle is not ready anymore then, so
+  Poller.Wait reports it as ready itself until every completion reaped was seen by its waiter.
+  the buffer is written by the kernel in place, it is kept alive by the frame of the yielding fiber and
+  collected memory does not move.
+  a ticket is the address of the operation record, it is freed by Finish. operations are only submitted,
+  tested and reaped on the thread that owns the ring, Finish can run anywhere.
+*/
+
+#define RING_ENTRIES 256
+
+#ifdef RING_SUPPORTED
+typedef struct
+{
+  long result;
+  bool done;
+  bool seen;
+} ring_operation;
+
+pluk_thread_local int ringState;
+pluk_thread_local int ringHandle = -1;
+pluk_thread_local unsigned ringPending;
+// reaped but not yet seen by their waiter
+pluk_thread_local size_t ringUnseen;
+pluk_thread_local unsigned* ringSqHead;
+pluk_thread_local unsigned* ringSqTail;
+pluk_thread_local unsigned ringSqMask;
+pluk_thread_local unsigned ringSqEntries;
+pluk_thread_local unsigned* ringSqArray;
+pluk_thread_local struct io_uring_sqe* ringSqes;
+pluk_thread_local unsigned* ringCqHead;
+pluk_thread_local unsigned* ringCqTail;
+pluk_thread_local unsigned ringCqMask;
+pluk_thread_local struct io_uring_cqe* ringCqes;
+
+#define RING_OPEN 1
+#define RING_UNAVAILABLE 2
+
+bool ringConfigured()
+{
+  char* setting = getenv("PLUK_IO_URING");
+  return setting && (strtol(setting, 0, 10) > 0);
+}
+
+/* maps the rings of the calling thread, false if io_uring is off or can not be used */
+bool ringOpen()
+{
+  if (ringState)
+    return ringState == RING_OPEN;
+  ringState = RING_UNAVAILABLE;
+  if (!ringConfigured())
+    return false;
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (fd < 0)
+    return false;
+  // transfers at the current position came with 5.6
+  if (!(params.features & IORING_FEAT_RW_CUR_POS))
+  {
+    close(fd);
+    return false;
+  }
+  size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && (cqSize > sqSize))
+    sqSize = cqSize;
+  unsigned char* sq = mmap(0, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED)
+  {
+    close(fd);
+    return false;
+  }
+  unsigned char* cq = sq;
+  if (!single)
+  {
+    cq = mmap(0, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED)
+    {
+      munmap(sq, sqSize);
+      close(fd);
+      return false;
+    }
+  }
+  void* sqes = mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    if (!single)
+      munmap(cq, cqSize);
+    munmap(sq, sqSize);
+    close(fd);
+    return false;
+  }
+  ringSqHead = (unsigned*)(sq + params.sq_off.head);
+  ringSqTail = (unsigned*)(sq + params.sq_off.tail);
+  ringSqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+  ringSqEntries = params.sq_entries;
+  ringSqArray = (unsigned*)(sq + params.sq_off.array);
+  ringSqes = sqes;
+  ringCqHead = (unsigned*)(cq + params.cq_off.head);
+  ringCqTail = (unsigned*)(cq + params.cq_off.tail);
+  ringCqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+  ringCqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  ringHandle = fd;
+  ringState = RING_OPEN;
+  return true;
+}
+
+void ringReap()
+{
+  unsigned head = *ringCqHead;
+  unsigned tail = __atomic_load_n(ringCqTail, __ATOMIC_ACQUIRE);
+  while (head != tail)
+  {
+    struct io_uring_cqe* cqe = &ringCqes[head & ringCqMask];
+    ring_operation* operation = (ring_operation*)(size_t)cqe->user_data;
+    operation->result = cqe->res;
+    operation->done = true;
+    ringUnseen++;
+    head++;
+  }
+  __atomic_store_n(ringCqHead, head, __ATOMIC_RELEASE);
+}
+
+/* submits the queued operations of the calling thread and takes in the completions */
+void ring_flush()
+{
+  if (ringState != RING_OPEN)
+    return;
+  ringReap();
+  while (ringPending)
+  {
+    int submitted = syscall(__NR_io_uring_enter, ringHandle, ringPending, 0, 0, 0, 0);
+    if (submitted < 0)
+    {
+      // out of resources for now, they go with the next flush
+      if (errno != EINTR)
+        return;
+      continue;
+    }
+    ringPending -= submitted;
+  }
+}
+
+/* the ring handle when Poller.Wait has to report it ready, -1 otherwise */
+int ring_ready()
+{
+  return ringUnseen ? ringHandle : -1;
+}
+#else
+void ring_flush()
+{
+}
+
+int ring_ready()
+{
+  return -1;
+}
+#endif
+
+/* static extern bool Available() */
+pref pluk_io_Ring__Available(pref this)
+{
+#ifdef RING_SUPPORTED
+  return boolToPref(ringOpen());
+#else
+  return boolToPref(false);
+#endif
+}
+
+/* static extern int Handle() */
+pref pluk_io_Ring__Handle(pref this)
+{
+#ifdef RING_SUPPORTED
+  return longToPref(ringHandle);
+#else
+  return longToPref(-1);
+#endif
+}
+
+/* static extern int Submit(int handle, Array<Byte> buffer, int offset, int length, bool write, bool socket) */
+pref pluk_io_Ring__Submit(pref this, pref handle, pref buffer, pref offset, pref length, pref write, pref socket)
+{
+#ifdef RING_SUPPORTED
+  if (!ringOpen())
+    return longToPref(0);
+  unsigned tail = *ringSqTail;
+  if (tail - __atomic_load_n(ringSqHead, __ATOMIC_ACQUIRE) == ringSqEntries)
+  {
+    ring_flush();
+    if (tail - __atomic_load_n(ringSqHead, __ATOMIC_ACQUIRE) == ringSqEntries)
+      return longToPref(0);
+  }
+  ring_operation* operation = malloc(sizeof(ring_operation));
+  if (!operation)
+    return longToPref(0);
+  operation->result = 0;
+  operation->done = false;
+  operation->seen = false;
+  unsigned index = tail & ringSqMask;
+  struct io_uring_sqe* sqe = &ringSqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->fd = longFromPref(handle);
+  sqe->addr = (size_t)&(bptrFromPref(buffer)[longFromPref(offset)]);
+  sqe->len = sizetFromPref(length);
+  if (boolFromPref(socket))
+  {
+    // a write to a closed connection would raise SIGPIPE
+    sqe->opcode = boolFromPref(write) ? IORING_OP_SEND : IORING_OP_RECV;
+    sqe->msg_flags = MSG_NOSIGNAL;
+  }
+  else
+  {
+    sqe->opcode = boolFromPref(write) ? IORING_OP_WRITE : IORING_OP_READ;
+    // at the position of the handle, as read and write do
+    sqe->off = (__u64)-1;
+  }
+  sqe->user_data = (size_t)operation;
+  ringSqArray[index] = index;
+  __atomic_store_n(ringSqTail, tail + 1, __ATOMIC_RELEASE);
+  ringPending++;
+  return longToPref((long)operation);
+#else
+  return longToPref(0);
+#endif
+}
+
+/* static extern bool Completed(int ticket) */
+pref pluk_io_Ring__Completed(pref this, pref ticket)
+{
+#ifdef RING_SUPPORTED
+  ring_operation* operation = (ring_operation*)longFromPref(ticket);
+  if (!operation->done)
+    ringReap();
+  if (!operation->done)
+    return boolToPref(false);
+  if (!operation->seen)
+  {
+    operation->seen = true;
+    ringUnseen--;
+  }
+  return boolToPref(true);
+#else
+  return boolToPref(true);
+#endif
+}
+
+/* static extern int Finish(int ticket) */
+pref pluk_io_Ring__Finish(pref this, pref ticket)
+{
+#ifdef RING_SUPPORTED
+  ring_operation* operation = (ring_operation*)longFromPref(ticket);
+  long result = operation->result;
+  free(operation);
+  return longToPref(result);
+#else
+  return longToPref(-EINVAL);
+#endif
+}
+
+/* static extern int WouldBlock() */
+pref pluk_io_Ring__WouldBlock(pref this)
+{
+  return longToPref(-EAGAIN);
+}
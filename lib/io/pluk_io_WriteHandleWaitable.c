@@ -2,10 +2,9 @@
 
 #include <errno.h>
 #include <unistd.h>
-#include <sys/time.h>
 #ifdef pwin32
 #else
-#include <sys/select.h>
+#include <poll.h>
 #endif
 #include <sys/types.h>
 
@@ -15,15 +14,16 @@ pref pluk_io_WriteHandleWaitable__InnerTest(pref this)
   // only used for file handles, filehandles are currently blocking only on windows
   return boolToPref(true);
 #else
-  int handle = longFromPref(fieldFromPref(this, 0));
-  fd_set writeSet;
-  FD_ZERO(&writeSet);
-  FD_SET(handle, &writeSet);
-  int res;
-  struct timeval timeout;
-  timeout.tv_sec = 0;
-  timeout.tv_usec = 0;
-  res = select(FD_SETSIZE, NULL, &writeSet, NULL, &timeout);
+  struct pollfd handle;
+  handle.fd = longFromPref(fieldFromPref(this, 0));
+  handle.events = POLLOUT;
+  handle.revents = 0;
+  int res = poll(&handle, 1, 0);
+  if ((res > 0) && (handle.revents & POLLNVAL))
+  {
+    errno = EBADF;
+    res = -1;
+  }
   if (res == -1)
     fieldFromPref(this, 1) = longToPref(errno);
   return boolToPref(res > 0);
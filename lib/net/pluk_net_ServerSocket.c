@@ -1,6 +1,8 @@
+#define _GNU_SOURCE
 #include <pluk.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -14,8 +16,8 @@
 // [1] int errorno
 // [2] int errorkind
 
-// private bool Open(string port)
-pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
+// private bool Open(string port, int backlog, bool reusePort)
+pref pluk_net_ServerSocket__InnerOpen(pref this, pref port, pref backlog, pref reusePort)
 {
   int sockfd;
   struct addrinfo hints, *servinfo, *p;
@@ -51,6 +53,21 @@ pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
       close(sockfd);
       continue;
     }
+    if (boolFromPref(reusePort))
+    {
+#ifdef SO_REUSEPORT
+      if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &ra, sizeof(ra)) == -1)
+      {
+        error = errno;
+        close(sockfd);
+        continue;
+      }
+#else
+      error = ENOPROTOOPT;
+      close(sockfd);
+      continue;
+#endif
+    }
     if (bind(sockfd, p->ai_addr, p->ai_addrlen) == -1)
     {
       error = errno;
@@ -59,6 +76,7 @@ pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
     }
     break; // if we get here, we must have connected successfully
   }
+  freeaddrinfo(servinfo);
   if (p == NULL)
   {
     fieldFromPref(this, 0) = longToPref(0);
@@ -67,7 +85,11 @@ pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
     return boolToPref(false);  
   }
   error = 0;
-  if (listen(sockfd, 2) == -1)
+  int queued = longFromPref(backlog);
+  // the system caps it at its own limit
+  if (queued <= 0)
+    queued = INT_MAX;
+  if (listen(sockfd, queued) == -1)
   {
     error = errno;
     close(sockfd);    
@@ -108,7 +130,11 @@ pref pluk_net_ServerSocket__InnerAccept(pref this)
   
   fd = longFromPref(fieldFromPref(this, 0));
   len = sizeof(from);
+#ifdef SOCK_NONBLOCK
+  g = accept4(fd, (struct sockaddr*) &from, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
   g = accept(fd, (struct sockaddr*) &from, &len);
+#endif
   if (g == -1)
   {
     int error;
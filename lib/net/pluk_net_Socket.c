@@ -15,24 +15,39 @@
 // [1] int errorno
 // [2] int errorkind
 
-// bool InnerOpenSocket(string host, string port)
-pref pluk_net_Socket__InnerOpenSocket(pref this, pref host, pref port)
+/*
+  from a fiber the name lookup and connect go to the offload pool, StartOpenSocket returns the job as ticket or
+  0 when the pool did not take it, the fiber then calls InnerOpenSocket itself.
+*/
+
+typedef struct
+{
+  offload_job job;
+  char* host;
+  char* port;
+  int handle;
+  int error;
+  int kind;
+} socket_open;
+
+void socketOpen(offload_job* job)
 {
+  socket_open* request = (socket_open*)job;
   int sockfd;  
   struct addrinfo hints, *servinfo, *p;
   int rv;
 
+  request->handle = 0;
   memset(&hints, 0, sizeof(hints));
   hints.ai_family = AF_UNSPEC;
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_protocol = IPPROTO_TCP;
 
-  if ((rv = getaddrinfo(cstrFromPref(host), cstrFromPref(port), &hints, &servinfo)) != 0)
+  if ((rv = getaddrinfo(request->host, request->port, &hints, &servinfo)) != 0)
   {
-    fieldFromPref(this, 0) = longToPref(0);
-    fieldFromPref(this, 1) = longToPref(rv);
-    fieldFromPref(this, 2) = longToPref(1);
-    return boolToPref(false);
+    request->error = rv;
+    request->kind = 1;
+    return;
   }
   int error = 0;
   // loop through all the results and connect to the first we can
@@ -56,10 +71,9 @@ pref pluk_net_Socket__InnerOpenSocket(pref this, pref host, pref port)
   {
     // looped off the end of the list with no connection
     // retry or raise first error
-    fieldFromPref(this, 0) = longToPref(0);
-    fieldFromPref(this, 1) = longToPref(error);
-    fieldFromPref(this, 2) = longToPref(0);
-    return boolToPref(false);
+    request->error = error;
+    request->kind = 0;
+    return;
   }
   
   int flag;
@@ -69,14 +83,64 @@ pref pluk_net_Socket__InnerOpenSocket(pref this, pref host, pref port)
   if (rv == -1)
   {
     close(sockfd);
-    fieldFromPref(this, 0) = longToPref(0);
-    fieldFromPref(this, 1) = longToPref(rv);
-    fieldFromPref(this, 2) = longToPref(0);
-    return boolToPref(false);
+    request->error = rv;
+    request->kind = 0;
+    return;
   }  
   
-  fieldFromPref(this, 0) = longToPref(sockfd);
-  return boolToPref(true);                  
+  request->handle = sockfd;
+}
+
+pref socketOpened(pref this, socket_open* request)
+{
+  fieldFromPref(this, 0) = longToPref(request->handle);
+  if (request->handle)
+    return boolToPref(true);
+  fieldFromPref(this, 1) = longToPref(request->error);
+  fieldFromPref(this, 2) = longToPref(request->kind);
+  return boolToPref(false);
+}
+
+// bool InnerOpenSocket(string host, string port)
+pref pluk_net_Socket__InnerOpenSocket(pref this, pref host, pref port)
+{
+  socket_open request;
+  request.host = cstrFromPref(host);
+  request.port = cstrFromPref(port);
+  socketOpen(&request.job);
+  return socketOpened(this, &request);
+}
+
+// int StartOpenSocket(string host, string port)
+pref pluk_net_Socket__StartOpenSocket(pref this, pref host, pref port)
+{
+  socket_open* request = malloc(sizeof(socket_open));
+  if (!request)
+    return longToPref(0);
+  // the worker can not read collected memory
+  request->host = strdup(cstrFromPref(host));
+  request->port = strdup(cstrFromPref(port));
+  request->job.run = socketOpen;
+  if (!request->host || !request->port || !offload_submit(&request->job))
+  {
+    free(request->host);
+    free(request->port);
+    free(request);
+    return longToPref(0);
+  }
+  return longToPref((long)request);
+}
+
+// bool FinishOpenSocket(int ticket)
+pref pluk_net_Socket__FinishOpenSocket(pref this, pref ticket)
+{
+  socket_open* request = (socket_open*)longFromPref(ticket);
+  offload_finish(&request->job);
+  pref result = socketOpened(this, request);
+  free(request->host);
+  free(request->port);
+  free(request);
+  return result;
 }
 
 // internal bool Open(int port)
@@ -189,3 +253,9 @@ pref pluk_net_Socket__InnerRead(pref this, pref buffer, pref offset, pref limit)
     res = -1;
   return longToPref(res);
 }
+
+// static int ConnectionReset()
+pref pluk_net_Socket__ConnectionReset(pref this)
+{
+  return longToPref(-ECONNRESET);
+}
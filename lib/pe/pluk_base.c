@@ -15,6 +15,8 @@ pref emptyString;
 
 extern size_t* gc_globalsBegin;
 extern size_t* gc_globalsEnd;
+void gc_registerBarrier(size_t* barrier);
+void gc_configure();
 
 typedef struct
 {
@@ -31,7 +33,7 @@ void pluk_base_exit(int status)
   exit(status);
 }
 
-void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfloat, size_t* pbstring, size_t* pbstaticstring, size_t* pbtype, size_t* stackTraceData, size_t* staticDataSlotsBegin, size_t* staticDataSlotsEnd, size_t* overflowType, size_t* boundsType)
+void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfloat, size_t* pbstring, size_t* pbstaticstring, size_t* pbtype, size_t* stackTraceData, size_t* staticDataSlotsBegin, size_t* staticDataSlotsEnd, size_t* overflowType, size_t* boundsType, size_t* barrier)
 {
   pluk_base_Bool = pbbool;
   pluk_base_Byte = pbbyte;
@@ -52,6 +54,8 @@ void pluk_base_setup(size_t* pbbool, size_t* pbbyte, size_t* pbint, size_t* pbfl
   
   gc_globalsBegin = staticDataSlotsBegin;
   gc_globalsEnd = staticDataSlotsEnd;
+  gc_registerBarrier(barrier);
+  gc_configure();
 }
 
 void pluk_base_saveStackRoot(size_t* stackRoot)
@@ -36,6 +36,13 @@ extern pref emptyString;
 #define pluk_float_t float
 #endif 
 
+/* state every thread keeps for itself, there is only the one thread on windows */
+#ifdef pwin32
+#define pluk_thread_local
+#else
+#define pluk_thread_local __thread
+#endif
+
 #define longFromPref(number) ((long)(number).value)
 pluk_float_t floatFromPref(pref number);
 #define sizetFromPref(number) ((size_t)(number).value)
@@ -43,6 +50,9 @@ pluk_float_t floatFromPref(pref number);
 #define boolFromPref(number) (longFromPref(number)?true:false)
 #define bptrFromPref(array) ((unsigned char*)((array).value[0]))
 
+/* the generated code keeps no 16 byte stack alignment, runtime functions that start threads realign on entry */
+#define realignedStack __attribute__((force_align_arg_pointer))
+
 #define fieldFromPref(self, offset) (((pref*)(self).value)[(offset)])
 
 pref strToPref(size_t* str);
@@ -63,5 +73,23 @@ size_t* pluk_allocateGC(size_t fieldCount, size_t additionalBytes, size_t* stack
 void pluk_touchGC(pref* reference);
 void pluk_disposeGC(size_t* value, size_t* type);
 void pluk_fullSweepGC(size_t* stackTrace);
+/* roots every thread keeps for itself, see pluk_threadLocal */
+#define PLUK_LOCAL_FIBER 0
+#define PLUK_LOCAL_PROCESSOR 1
+#define PLUK_LOCAL_HOST 2
+#define PLUK_LOCAL_COUNT 3
+pref* pluk_threadLocal(size_t index);
+
+/* a blocking call run by the offload pool, the first member of the job of the caller, see Offload.c */
+typedef struct offload_job
+{
+  void (*run)(struct offload_job* job);
+  struct offload_job* next;
+  int event;
+  bool done;
+} offload_job;
+bool offload_submit(offload_job* job);
+bool offload_done(offload_job* job);
+void offload_finish(offload_job* job);
 
 #endif /* g_pluk_h */
@@ -7,6 +7,7 @@ typedef struct
   size_t* file;
   size_t* class;
   size_t* field;
+  size_t* frameMap;
 } traceinfo;
 
 extern traceinfo* pluk_base_stackTraceData;
@@ -68,6 +69,32 @@ traceinfo* findTraceInfo(frame* frame)
   return 0;
 }
 
+// [0] variable count of the calling function, followed by a bitmap of the variables the GC can skip
+size_t* findFrameMap(void* retSite)
+{
+  if (!retSite || !pluk_base_stackTraceData)
+    return 0;
+  if (!stackTraceHashBuild)
+    buildStackTraceHash();
+  if (!stackTraceEntryCount)
+    return 0;
+
+  size_t hash = (size_t)retSite;
+  hash = hash ^ (hash >> 7);
+  hash = hash % stackTraceEntryCount;
+
+  traceinfo* ti = pluk_base_stackTraceData;
+
+  int i = stackTraceIndex[hash];
+  while (i)
+  {
+    if (ti[i].retSite == retSite)
+      return ti[i].frameMap;
+    i = stackTraceChain[i];
+  }
+  return 0;
+}
+
 /* extern void InnerThrow() */
 pref pluk_base_Exception__InnerThrow(pref this, frame* stackFrame)
 {
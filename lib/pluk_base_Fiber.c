@@ -1,5 +1,13 @@
+#define _DEFAULT_SOURCE
 #include <pluk.h>
 
+#ifndef pwin32
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "3rdparty/valgrind/valgrind.h"
 
 //stacklayout
@@ -12,23 +20,184 @@
 
 // 6*w valgrindStackId
 // 7*w stackSize
+// 10*w start of the stack mapping, the guard page
+// 11*w size of the stack mapping
 
 // at phase 1
 
 // 2*w gc space0
 // 3*w gc space1
+// 8*w gc stamp of the last full mark that scanned the suspended stack
+// 9*w gc stamp of the last minor collection that scanned it
+// 12*w record of the fiber that ran before this one was switched to
 
 
 // stacked:
 // -2*w return into yieldAtTermination
 // -1*w zero (marks stack end)
 
+/*
+  stacks are mapped outside of the collected heap, below each one a guard page turns an overflow into a fault
+  instead of overwriting whatever comes next. the system commits the pages once they are touched, so a fiber only
+  costs the depth it actually reached. the stack of a terminated fiber goes into a pool and is handed out again
+  without being cleared, the collector only looks at the frames of a stack. every mapping is two regions for the
+  system, and the system refuses any new mapping, even for malloc, once vm.max_map_count is reached. so only half
+  of that is spent on stacks, the stacks past it go into the fiber record in the collected heap, without guard page,
+  as do stacks the system refuses to map.
+*/
+#define FIBER_RECORD_WORDS 13
+#define FIBER_POOL_MAX 1024
+
+typedef struct fiber_stack fiber_stack;
+
+/* kept in the top bytes of a pooled stack */
+struct fiber_stack
+{
+  fiber_stack* next;
+  size_t size;
+};
+
+fiber_stack* fiberPool;
+size_t fiberPoolCount;
+size_t fiberPageSize;
+// stacks mapped, pooled ones included, and how many may be
+size_t fiberMapped;
+size_t fiberMapLimit;
+
+#ifndef pwin32
+pthread_mutex_t fiberPoolLock = PTHREAD_MUTEX_INITIALIZER;
+#define fiber_lock() pthread_mutex_lock(&fiberPoolLock)
+#define fiber_unlock() pthread_mutex_unlock(&fiberPoolLock)
+#else
+#define fiber_lock()
+#define fiber_unlock()
+#endif
+
 void fiber_setup(size_t* base);
 void fiber_switch(size_t* base, size_t* stackTrace);
+void fiber_transfer(size_t* from, size_t* to, size_t* stackTrace);
+
+/* the top of the stack of a mapping of size bytes starting at base */
+#define fiber_stackTop(base, size) ((unsigned char*)(base) + (size))
+
+void fiber_configure()
+{
+#ifdef pwin32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  fiberPageSize = info.dwPageSize;
+  fiberMapLimit = (size_t)-1;
+#else
+  fiberPageSize = (size_t)sysconf(_SC_PAGESIZE);
+  // stdio needs an aligned stack, the generated code does not keep one
+  long mapCount = 65530;
+  char text[32];
+  int setting = open("/proc/sys/vm/max_map_count", O_RDONLY);
+  if (setting >= 0)
+  {
+    ssize_t length = read(setting, text, sizeof(text) - 1);
+    if (length > 0)
+    {
+      text[length] = 0;
+      mapCount = strtol(text, 0, 10);
+    }
+    close(setting);
+  }
+  // two regions a stack
+  fiberMapLimit = (size_t)mapCount / 4;
+#endif
+}
+
+/* returns the mapping, guard page included, of a stack of atleast stackSize bytes, or 0 when there is none left */
+void* fiber_mapStack(size_t stackSize, size_t* size)
+{
+  if (!fiberPageSize)
+    fiber_configure();
+  *size = ((stackSize + fiberPageSize - 1) & ~(fiberPageSize - 1)) + fiberPageSize;
+  fiber_stack** link;
+  fiber_lock();
+  for (link = &fiberPool; *link; link = &(*link)->next)
+    if ((*link)->size == *size)
+    {
+      fiber_stack* pooled = *link;
+      *link = pooled->next;
+      fiberPoolCount--;
+      fiber_unlock();
+      return fiber_stackTop(pooled, sizeof(fiber_stack)) - *size;
+    }
+  if (fiberMapped >= fiberMapLimit)
+  {
+    fiber_unlock();
+    return 0;
+  }
+  fiberMapped++;
+  fiber_unlock();
+#ifdef pwin32
+  void* base = VirtualAlloc(NULL, *size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  DWORD previous;
+  if (base && !VirtualProtect(base, fiberPageSize, PAGE_NOACCESS, &previous))
+  {
+    VirtualFree(base, 0, MEM_RELEASE);
+    base = 0;
+  }
+#else
+  void* base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED)
+    base = 0;
+  else if (mprotect(base, fiberPageSize, PROT_NONE))
+  {
+    munmap(base, *size);
+    base = 0;
+  }
+#endif
+  if (!base)
+  {
+    fiber_lock();
+    fiberMapped--;
+    fiber_unlock();
+  }
+  return base;
+}
+
+void fiber_unmapStack(void* base, size_t size)
+{
+  fiber_lock();
+  if (fiberPoolCount < FIBER_POOL_MAX)
+  {
+    fiber_stack* pooled = (fiber_stack*)(fiber_stackTop(base, size) - sizeof(fiber_stack));
+    pooled->next = fiberPool;
+    pooled->size = size;
+    fiberPool = pooled;
+    fiberPoolCount++;
+    fiber_unlock();
+    return;
+  }
+  fiberMapped--;
+  fiber_unlock();
+#ifdef pwin32
+  VirtualFree(base, 0, MEM_RELEASE);
+#else
+  munmap(base, size);
+#endif
+}
+
+/* once the fiber terminated and its stack was left for good */
+void fiber_releaseStack(size_t* store)
+{
+  if (!store[10])
+    return;
+  fiber_unmapStack((void*)store[10], store[11]);
+  store[10] = 0;
+}
 
 // from GC.c
 void gc_registerFiber(size_t* fiber);
 void gc_unregisterFiber(size_t* fiber);
+size_t* gc_enterFiber(size_t* fiber);
+void* gc_addThread(pref host, size_t* stackTrace);
+void gc_dropThread(void* thread);
+void gc_enterThread(void* thread);
+void gc_leaveThread();
 
 //private extern void Init(int stackSize, void() entrypoint);
 pref pluk_base_Fiber__Init(pref this, pref stackSize, pref entryPoint)
@@ -36,19 +205,35 @@ pref pluk_base_Fiber__Init(pref this, pref stackSize, pref entryPoint)
   pref* holder;
   holder = &fieldFromPref(this, 0);
   holder->type = pluk_base_String; //lying
-  holder->value = pluk_allocateGC(0, 8* sizeof(size_t*) + longFromPref(stackSize), 0);
+  size_t size;
+  void* base = fiber_mapStack(longFromPref(stackSize), &size);
+  // without a mapping the stack follows the record
+  size_t heapStack = base ? 0 : (size_t)longFromPref(stackSize);
+  holder->value = pluk_allocateGC(0, FIBER_RECORD_WORDS * sizeof(size_t*) + heapStack, 0);
+  pluk_touchGC(holder);
   size_t** s = (size_t**)holder->value;
   
-  void* stack = &s[8];
-  
-  s[0] = (size_t*)((unsigned char*)stack + longFromPref(stackSize));
+  if (base)
+  {
+    s[0] = (size_t*)fiber_stackTop(base, size);
+    s[7] = (size_t*)(size - fiberPageSize);
+  }
+  else
+  {
+    s[0] = (size_t*)fiber_stackTop(&s[FIBER_RECORD_WORDS], heapStack);
+    s[7] = (size_t*)heapStack;
+  }
   s[1] = 0;
   s[2] = 0;
   s[3] = 0;
   s[4] = entryPoint.type;
   s[5] = entryPoint.value;
   s[6] = 0;
-  s[7] = (size_t*)longFromPref(stackSize);
+  s[8] = 0;
+  s[9] = 0;
+  s[10] = base;
+  s[11] = (size_t*)size;
+  s[12] = 0;
   
   s[6] = 
   (size_t*)(size_t)VALGRIND_STACK_REGISTER(
@@ -65,6 +250,10 @@ pref pluk_base_Fiber__SwitchToMain(pref this, size_t* stackTrace)
 {
   size_t* store;
   store = fieldFromPref(this, 0).value;
+  // the record takes the stack of this fiber, the invoker runs again
+  store[8] = 0;
+  store[9] = 0;
+  gc_enterFiber((size_t*)store[12]);
   fiber_switch(store, stackTrace);
   return nullToPref();
 }
@@ -74,9 +263,31 @@ pref pluk_base_Fiber__SwitchToFiber(pref this, size_t* stackTrace)
 {
   size_t* store;
   store = fieldFromPref(this, 0).value;
+  // the record takes the stack of the invoker, which is left for this fiber
+  store[8] = 0;
+  store[9] = 0;
+  store[12] = (size_t)gc_enterFiber(store);
   fiber_switch(store, stackTrace);
   return nullToPref();
 }
+//private extern void Transfer(Fiber other);
+pref pluk_base_Fiber__Transfer(pref this, pref other, size_t* stackTrace)
+{
+  size_t* from;
+  size_t* to;
+  from = fieldFromPref(this, 0).value;
+  to = fieldFromPref(other, 0).value;
+  from[8] = 0;
+  from[9] = 0;
+  to[8] = 0;
+  to[9] = 0;
+  // to runs in place of from, for the same invoker
+  to[12] = from[12];
+  gc_enterFiber(to);
+  fiber_transfer(from, to, stackTrace);
+  return nullToPref();
+}
+
 //private extern void RegisterStack();
 pref pluk_base_Fiber__RegisterStack(pref this)
 {
@@ -96,3 +307,60 @@ pref pluk_base_Fiber__UnregisterStack(pref this)
   gc_unregisterFiber(store);
   return nullToPref();
 }
+
+//private extern void ReleaseStack();
+pref pluk_base_Fiber__ReleaseStack(pref this)
+{
+  fiber_releaseStack((size_t*)fieldFromPref(this, 0).value);
+  return nullToPref();
+}
+
+//private static extern Fiber? GetCurrent();
+pref pluk_base_Fiber__GetCurrent(pref this)
+{
+  return *pluk_threadLocal(PLUK_LOCAL_FIBER);
+}
+
+//private static extern void SetCurrent(Fiber? fiber);
+pref pluk_base_Fiber__SetCurrent(pref this, pref fiber)
+{
+  pref* slot = pluk_threadLocal(PLUK_LOCAL_FIBER);
+  *slot = fiber;
+  pluk_touchGC(slot);
+  return nullToPref();
+}
+
+#ifndef pwin32
+/* the thread has no pluk frames of its own, it switches to the fiber it hosts until that terminates */
+void* fiber_thread(void* thread)
+{
+  gc_enterThread(thread);
+  size_t* store = fieldFromPref(*pluk_threadLocal(PLUK_LOCAL_HOST), 0).value;
+  store[8] = 0;
+  store[9] = 0;
+  store[12] = (size_t)gc_enterFiber(store);
+  fiber_switch(store, 0);
+  // the hosted fiber, or the one it transferred to, terminated
+  fiber_releaseStack(fieldFromPref(*pluk_threadLocal(PLUK_LOCAL_FIBER), 0).value);
+  gc_leaveThread();
+  return 0;
+}
+#endif
+
+//private extern bool Start();
+realignedStack pref pluk_base_Fiber__Start(pref this, size_t* stackTrace)
+{
+#ifdef pwin32
+  return boolToPref(false);
+#else
+  void* thread = gc_addThread(this, stackTrace);
+  pthread_t handle;
+  if (pthread_create(&handle, 0, fiber_thread, thread))
+  {
+    gc_dropThread(thread);
+    return boolToPref(false);
+  }
+  pthread_detach(handle);
+  return boolToPref(true);
+#endif
+}
@@ -0,0 +1,70 @@
+#include <pluk.h>
+
+// from GC.c
+extern size_t allocationCount, lifeCount;
+extern size_t fullCollections, minorCollections, incrementalCycles;
+extern size_t fullPauseTotal, minorPauseTotal, maxPause;
+
+// from Heap.c
+size_t heap_bytes();
+size_t heap_liveBytes();
+
+/* static extern int Allocations() */
+pref pluk_base_GC__Allocations(pref this)
+{
+  return longToPref((long)allocationCount);
+}
+
+/* static extern int LiveObjects() */
+pref pluk_base_GC__LiveObjects(pref this)
+{
+  return longToPref((long)lifeCount);
+}
+
+/* static extern int LiveBytes() */
+pref pluk_base_GC__LiveBytes(pref this)
+{
+  return longToPref((long)heap_liveBytes());
+}
+
+/* static extern int HeapBytes() */
+pref pluk_base_GC__HeapBytes(pref this)
+{
+  return longToPref((long)heap_bytes());
+}
+
+/* static extern int FullCollections() */
+pref pluk_base_GC__FullCollections(pref this)
+{
+  return longToPref((long)fullCollections);
+}
+
+/* static extern int MinorCollections() */
+pref pluk_base_GC__MinorCollections(pref this)
+{
+  return longToPref((long)minorCollections);
+}
+
+/* static extern int IncrementalCycles() */
+pref pluk_base_GC__IncrementalCycles(pref this)
+{
+  return longToPref((long)incrementalCycles);
+}
+
+/* static extern int FullPauseMicroseconds() */
+pref pluk_base_GC__FullPauseMicroseconds(pref this)
+{
+  return longToPref((long)fullPauseTotal);
+}
+
+/* static extern int MinorPauseMicroseconds() */
+pref pluk_base_GC__MinorPauseMicroseconds(pref this)
+{
+  return longToPref((long)minorPauseTotal);
+}
+
+/* static extern int MaxPauseMicroseconds() */
+pref pluk_base_GC__MaxPauseMicroseconds(pref this)
+{
+  return longToPref((long)maxPause);
+}
@@ -11,10 +11,15 @@ pref pluk_base_PrimitiveArray__Alloc(pref this, pref count, pref initialValue)
   this.value[1] = (size_t)this.type;
   slot = (pref*)pluk_allocateGC((size_t)longFromPref(count), 0, 0);
   this.value[0] = (size_t)slot;
+  pluk_touchGC((pref*)this.value);
   long c = longFromPref(count);
   for (i = 0; i < c; ++i)
     slot[i] = initialValue;
   pluk_touchGC(&initialValue);
+  // large buffers are not allocated in the nursery, their slots need the write barrier
+  if (initialValue.value)
+    for (i = 0; i < c; ++i)
+      pluk_touchGC(&slot[i]);
   return result;
 }
 
@@ -52,6 +57,7 @@ pref pluk_base_PrimitiveArray__pluk_base_Bool__Alloc(pref this, pref count, pref
   this.value[1] = (size_t)this.type;
   slot = (signed char*)pluk_allocateGC(0, (size_t)longFromPref(count), 0);
   this.value[0] = (size_t)slot;
+  pluk_touchGC((pref*)this.value);
   memset(slot, (unsigned char)longFromPref(initialValue), longFromPref(count));
   return result;
 }
@@ -86,6 +92,7 @@ pref pluk_base_PrimitiveArray__pluk_base_Byte__Alloc(pref this, pref count, pref
   this.value[1] = (size_t)this.type;
   slot = (unsigned char*)pluk_allocateGC(0, (size_t)longFromPref(count), 0);
   this.value[0] = (size_t)slot;
+  pluk_touchGC((pref*)this.value);
   memset(slot, (unsigned char)longFromPref(initialValue), longFromPref(count));
   return result;
 }
@@ -123,6 +130,7 @@ pref pluk_base_PrimitiveArray__pluk_base_Int__Alloc(pref this, pref count, pref
   this.value[1] = (size_t)this.type;
   slot = (long*)pluk_allocateGC(0, sizeof(long)*(size_t)longFromPref(count), 0);
   this.value[0] = (size_t)slot;
+  pluk_touchGC((pref*)this.value);
   long c = longFromPref(count);
   for (i = 0; i < c; ++i)
     slot[i] = initial;
@@ -36,10 +36,16 @@ void pluk_net_Socket_Shutdown()
 // [0] int handle
 // [1] int errorno
 
-// private bool Open(string port)
-pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
+// private bool Open(string port, int backlog, bool reusePort)
+pref pluk_net_ServerSocket__InnerOpen(pref this, pref port, pref backlog, pref reusePort)
 {
   int error = pluk_net_Socket_Startup();
+  // there is no port sharing between listeners
+  if (!error && boolFromPref(reusePort))
+  {
+    pluk_net_Socket_Shutdown();
+    error = WSAEOPNOTSUPP;
+  }
   if (error)
   {
     fieldFromPref(this, 0) = longToPref(0);
@@ -107,7 +113,10 @@ pref pluk_net_ServerSocket__InnerOpen(pref this, pref port)
     return boolToPref(false);
   }
   error = 0;
-  if (listen(sockfd, 2) == -1)
+  int queued = longFromPref(backlog);
+  if (queued <= 0)
+    queued = SOMAXCONN;
+  if (listen(sockfd, queued) == -1)
   {
     error = WSAGetLastError();
     closesocket(sockfd);
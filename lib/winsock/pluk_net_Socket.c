@@ -203,3 +203,23 @@ pref pluk_net_Socket__InnerRead(pref this, pref buffer, pref offset, pref limit)
     res = -1;
   return longToPref(res);
 }
+
+// static int ConnectionReset()
+pref pluk_net_Socket__ConnectionReset(pref this)
+{
+  // there is no Ring on windows, no transfer result is ever compared with it
+  return longToPref(-WSAECONNRESET);
+}
+
+// int StartOpenSocket(string host, string port)
+pref pluk_net_Socket__StartOpenSocket(pref this, pref host, pref port)
+{
+  // nothing is offloaded on windows, InnerOpenSocket blocks
+  return longToPref(0);
+}
+
+// bool FinishOpenSocket(int ticket)
+pref pluk_net_Socket__FinishOpenSocket(pref this, pref ticket)
+{
+  return boolToPref(false);
+}
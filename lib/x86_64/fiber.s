@@ -68,3 +68,25 @@ fiber_switch_inner:
 	movq	%rsp, (%rdi)
 	movq	%rdx, %rsp
 	ret
+
+# switches from the running fiber in from straight to the suspended one in to,
+# to takes over the side from was switched to by so its next fiber_switch
+# returns there, from is left like after a fiber_switch of its own
+.globl fiber_transfer
+fiber_transfer:
+	pushq	%rbp
+	movq	%rsp, %rbp
+	call	fiber_transfer_inner@PLT
+	popq	%rbp
+	ret
+
+fiber_transfer_inner:
+	movq	8(%rdi), %rcx
+	movq	%rcx, 8(%rsi)
+	movq	%rdx, 8(%rdi)
+	movq	(%rdi), %rcx
+	movq	%rsp, (%rdi)
+	movq	(%rsi), %rdx
+	movq	%rcx, (%rsi)
+	movq	%rdx, %rsp
+	ret